@@ -0,0 +1,229 @@
+/*
+Counters and latency histograms exported on DBus.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "appmenu-metrics.h"
+#include "appmenu-recorder.h"
+#include "gen-appmenu-metrics.xml.h"
+
+/* Enough for samples up to a bit over half an hour */
+#define HISTOGRAM_BUCKETS 32
+
+typedef struct _Histogram Histogram;
+struct _Histogram {
+	volatile gsize count;
+	volatile gsize sum;
+	volatile gint buckets[HISTOGRAM_BUCKETS];
+};
+
+/* Everything is static so that recording never allocates, it's
+   just atomic adds on memory that's always there */
+static volatile gint counters[APPMENU_COUNTER_LAST];
+static Histogram histograms[APPMENU_HISTOGRAM_LAST];
+static gint64 start_time = 0;
+
+static const gchar * counter_names[APPMENU_COUNTER_LAST] = {
+	[APPMENU_COUNTER_REGISTRATIONS] =    "registrations",
+	[APPMENU_COUNTER_UNREGISTRATIONS] =  "unregistrations",
+	[APPMENU_COUNTER_FOCUS_CHANGES] =    "focus-changes",
+	[APPMENU_COUNTER_FOCUS_ELIDED] =     "focus-elided",
+	[APPMENU_COUNTER_ROOT_REBUILDS] =    "root-rebuilds",
+	[APPMENU_COUNTER_ABOUT_TO_SHOW] =    "about-to-show",
+	[APPMENU_COUNTER_RETRY_PINGS] =      "retry-pings",
+	[APPMENU_COUNTER_WINDOWS_DBUSMENU] = "windows-dbusmenu",
+	[APPMENU_COUNTER_WINDOWS_MODEL] =    "windows-model"
+};
+
+static const gchar * histogram_names[APPMENU_HISTOGRAM_LAST] = {
+	[APPMENU_HISTOGRAM_FOCUS_LATENCY] =  "focus-latency",
+	[APPMENU_HISTOGRAM_ROOT_REBUILD] =   "root-rebuild",
+	[APPMENU_HISTOGRAM_ABOUT_TO_SHOW] =  "about-to-show"
+};
+
+static void metrics_method_call (GDBusConnection * connection,
+                                 const gchar * sender,
+                                 const gchar * object_path,
+                                 const gchar * interface,
+                                 const gchar * method,
+                                 GVariant * params,
+                                 GDBusMethodInvocation * invocation,
+                                 gpointer user_data);
+
+static GDBusNodeInfo *      node_info = NULL;
+static GDBusInterfaceInfo * interface_info = NULL;
+static GDBusInterfaceVTable interface_table = {
+       method_call:    metrics_method_call,
+       get_property:   NULL, /* No properties */
+       set_property:   NULL  /* No properties */
+};
+
+/* Count one more of @counter */
+void
+appmenu_metrics_count (AppmenuCounter counter)
+{
+	g_return_if_fail(counter < APPMENU_COUNTER_LAST);
+	g_atomic_int_inc(&counters[counter]);
+	return;
+}
+
+/* Move a counter that goes both ways, like the number of windows */
+void
+appmenu_metrics_add (AppmenuCounter counter, gint delta)
+{
+	g_return_if_fail(counter < APPMENU_COUNTER_LAST);
+	g_atomic_int_add(&counters[counter], delta);
+	return;
+}
+
+guint
+appmenu_metrics_get (AppmenuCounter counter)
+{
+	g_return_val_if_fail(counter < APPMENU_COUNTER_LAST, 0);
+	return (guint)g_atomic_int_get(&counters[counter]);
+}
+
+/* Add a sample of @usec microseconds to @histogram */
+void
+appmenu_metrics_record (AppmenuHistogram histogram, gint64 usec)
+{
+	g_return_if_fail(histogram < APPMENU_HISTOGRAM_LAST);
+	Histogram * h = &histograms[histogram];
+
+	if (usec < 0) {
+		usec = 0;
+	}
+
+	guint bucket = g_bit_storage((gulong)usec);
+	if (usec == 0) {
+		bucket = 0;
+	}
+	if (bucket >= HISTOGRAM_BUCKETS) {
+		bucket = HISTOGRAM_BUCKETS - 1;
+	}
+
+	g_atomic_pointer_add(&h->count, 1);
+	g_atomic_pointer_add(&h->sum, (gssize)usec);
+	g_atomic_int_inc(&h->buckets[bucket]);
+
+	return;
+}
+
+/* Build an a{sv} with all the metrics as they are right now */
+GVariant *
+appmenu_metrics_snapshot (void)
+{
+	GVariantBuilder builder;
+	guint i, j;
+
+	if (start_time == 0) {
+		start_time = g_get_monotonic_time();
+	}
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+	g_variant_builder_add(&builder, "{sv}", "uptime",
+	                      g_variant_new_uint64(g_get_monotonic_time() - start_time));
+
+	for (i = 0; i < APPMENU_COUNTER_LAST; i++) {
+		g_variant_builder_add(&builder, "{sv}", counter_names[i],
+		                      g_variant_new_uint32(appmenu_metrics_get(i)));
+	}
+
+	for (i = 0; i < APPMENU_HISTOGRAM_LAST; i++) {
+		Histogram * h = &histograms[i];
+		GVariantBuilder buckets;
+
+		g_variant_builder_init(&buckets, G_VARIANT_TYPE("au"));
+		for (j = 0; j < HISTOGRAM_BUCKETS; j++) {
+			g_variant_builder_add(&buckets, "u", (guint)g_atomic_int_get(&h->buckets[j]));
+		}
+
+		g_variant_builder_add(&builder, "{sv}", histogram_names[i],
+		                      g_variant_new("(tt@au)",
+		                                    (guint64)g_atomic_pointer_get(&h->count),
+		                                    (guint64)g_atomic_pointer_get(&h->sum),
+		                                    g_variant_builder_end(&buckets)));
+	}
+
+	return g_variant_builder_end(&builder);
+}
+
+/* A method has been called on the metrics object */
+static void
+metrics_method_call (GDBusConnection * connection, const gchar * sender,
+                     const gchar * object_path, const gchar * interface,
+                     const gchar * method, GVariant * params,
+                     GDBusMethodInvocation * invocation, gpointer user_data)
+{
+	if (g_strcmp0(method, "GetSnapshot") == 0) {
+		g_dbus_method_invocation_return_value(invocation,
+		                                      g_variant_new("(@a{sv})", appmenu_metrics_snapshot()));
+	} else if (g_strcmp0(method, "DumpTrace") == 0) {
+		guint seconds = 0;
+		g_variant_get(params, "(u)", &seconds);
+
+		gchar * trace = appmenu_recorder_dump(seconds);
+		g_dbus_method_invocation_return_value(invocation, g_variant_new("(s)", trace));
+		g_free(trace);
+	} else {
+		g_warning("Calling method '%s' on the metrics and it's unknown", method);
+		g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+		                                      "Unknown method '%s'", method);
+	}
+
+	return;
+}
+
+/* Put the metrics object on @connection, returns the registration
+   ID to unregister it with or zero on error */
+guint
+appmenu_metrics_export (GDBusConnection * connection, GError ** error)
+{
+	g_return_val_if_fail(G_IS_DBUS_CONNECTION(connection), 0);
+
+	if (start_time == 0) {
+		start_time = g_get_monotonic_time();
+	}
+
+	if (node_info == NULL) {
+		node_info = g_dbus_node_info_new_for_xml(_appmenu_metrics, error);
+		if (node_info == NULL) {
+			return 0;
+		}
+	}
+
+	if (interface_info == NULL) {
+		interface_info = g_dbus_node_info_lookup_interface(node_info, METRICS_IFACE);
+		if (interface_info == NULL) {
+			g_set_error_literal(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+			                    "Unable to find interface '" METRICS_IFACE "'");
+			return 0;
+		}
+	}
+
+	return g_dbus_connection_register_object(connection,
+	                                         METRICS_OBJECT,
+	                                         interface_info,
+	                                         &interface_table,
+	                                         NULL,
+	                                         NULL,
+	                                         error);
+}
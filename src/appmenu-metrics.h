@@ -0,0 +1,65 @@
+/*
+Counters and latency histograms exported on DBus.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __APPMENU_METRICS_H__
+#define __APPMENU_METRICS_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define METRICS_IFACE   "org.ayatana.AppMenu.Metrics"
+#define METRICS_OBJECT  "/org/ayatana/AppMenu/Metrics"
+
+typedef enum _AppmenuCounter AppmenuCounter;
+enum _AppmenuCounter {
+	APPMENU_COUNTER_REGISTRATIONS,
+	APPMENU_COUNTER_UNREGISTRATIONS,
+	APPMENU_COUNTER_FOCUS_CHANGES,
+	APPMENU_COUNTER_FOCUS_ELIDED,
+	APPMENU_COUNTER_ROOT_REBUILDS,
+	APPMENU_COUNTER_ABOUT_TO_SHOW,
+	APPMENU_COUNTER_RETRY_PINGS,
+	APPMENU_COUNTER_WINDOWS_DBUSMENU,
+	APPMENU_COUNTER_WINDOWS_MODEL,
+	APPMENU_COUNTER_LAST
+};
+
+typedef enum _AppmenuHistogram AppmenuHistogram;
+enum _AppmenuHistogram {
+	APPMENU_HISTOGRAM_FOCUS_LATENCY,
+	APPMENU_HISTOGRAM_ROOT_REBUILD,
+	APPMENU_HISTOGRAM_ABOUT_TO_SHOW,
+	APPMENU_HISTOGRAM_LAST
+};
+
+void       appmenu_metrics_count     (AppmenuCounter counter);
+void       appmenu_metrics_add       (AppmenuCounter counter,
+                                      gint delta);
+guint      appmenu_metrics_get       (AppmenuCounter counter);
+void       appmenu_metrics_record    (AppmenuHistogram histogram,
+                                      gint64 usec);
+
+GVariant * appmenu_metrics_snapshot  (void);
+
+guint      appmenu_metrics_export    (GDBusConnection * connection,
+                                      GError ** error);
+
+G_END_DECLS
+
+#endif
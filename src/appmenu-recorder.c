@@ -0,0 +1,168 @@
+/*
+Flight recorder of the last things the registrar did.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <unistd.h>
+
+#include "appmenu-recorder.h"
+
+/* Has to be a power of two, the index wraps with a mask */
+#define RING_SIZE 4096
+
+typedef struct _Record Record;
+struct _Record {
+	/* One more than the number of the event in the slot, or
+	   zero while it's being written */
+	volatile guint seq;
+	AppmenuEvent event;
+	guint xid;
+	guint detail;
+	gint64 time;
+	gint64 duration;
+};
+
+/* Static like the metrics, recording is a slot claimed with an
+   atomic add and some stores, the oldest event gets written over */
+static Record ring[RING_SIZE];
+static volatile gint head = 0;
+
+static const gchar * event_names[APPMENU_EVENT_LAST] = {
+	[APPMENU_EVENT_REGISTER] =       "register-window",
+	[APPMENU_EVENT_UNREGISTER] =     "unregister-window",
+	[APPMENU_EVENT_FOCUS_CHANGE] =   "focus-change",
+	[APPMENU_EVENT_FOCUS_APPLY] =    "focus-apply",
+	[APPMENU_EVENT_SWITCH_APP] =     "switch-app",
+	[APPMENU_EVENT_SWITCH_KEPT] =    "switch-kept",
+	[APPMENU_EVENT_ENTRY_ADDED] =    "entry-added",
+	[APPMENU_EVENT_ENTRY_REMOVED] =  "entry-removed",
+	[APPMENU_EVENT_ROOT_CHANGED] =   "root-changed",
+	[APPMENU_EVENT_RETRY_PING] =     "retry-ping"
+};
+
+static void
+record (AppmenuEvent event, guint xid, guint detail, gint64 time, gint64 duration)
+{
+	g_return_if_fail(event < APPMENU_EVENT_LAST);
+
+	guint seq = (guint)g_atomic_int_add(&head, 1);
+	Record * rec = &ring[seq & (RING_SIZE - 1)];
+
+	g_atomic_int_set(&rec->seq, 0);
+	rec->event = event;
+	rec->xid = xid;
+	rec->detail = detail;
+	rec->time = time;
+	rec->duration = duration;
+	g_atomic_int_set(&rec->seq, seq + 1);
+
+	return;
+}
+
+/* Something happened to @xid just now */
+void
+appmenu_recorder_mark (AppmenuEvent event, guint xid, guint detail)
+{
+	record(event, xid, detail, g_get_monotonic_time(), -1);
+	return;
+}
+
+/* Something that was started at @start for @xid is done */
+void
+appmenu_recorder_span (AppmenuEvent event, guint xid, guint detail, gint64 start)
+{
+	gint64 now = g_get_monotonic_time();
+
+	if (start <= 0 || start > now) {
+		start = now;
+	}
+
+	record(event, xid, detail, start, now - start);
+	return;
+}
+
+/* Write the events of the last @seconds, or all of them when
+   it's zero, as Chrome trace events in JSON.  They load right
+   into chrome://tracing or ui.perfetto.dev. */
+gchar *
+appmenu_recorder_dump (guint seconds)
+{
+	GString * json = g_string_new(NULL);
+	guint last = (guint)g_atomic_int_get(&head);
+	gint pid = (gint)getpid();
+	gint64 since = 0;
+	guint i;
+
+	if (seconds != 0) {
+		since = g_get_monotonic_time() - (gint64)seconds * G_USEC_PER_SEC;
+	}
+
+	g_string_append_printf(json,
+	                       "{\"displayTimeUnit\":\"ms\",\"traceEvents\":["
+	                       "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,"
+	                       "\"args\":{\"name\":\"indicator-appmenu\"}}",
+	                       pid);
+
+	for (i = last - MIN(last, RING_SIZE); i != last; i++) {
+		Record * slot = &ring[i & (RING_SIZE - 1)];
+		Record rec;
+
+		/* Copy it out, and don't use it if it got written
+		   over while we were copying */
+		if ((guint)g_atomic_int_get(&slot->seq) != i + 1) {
+			continue;
+		}
+		rec = *slot;
+		if ((guint)g_atomic_int_get(&slot->seq) != i + 1) {
+			continue;
+		}
+
+		if (rec.time < since) {
+			continue;
+		}
+
+		g_string_append_printf(json,
+		                       ",{\"name\":\"%s\",\"cat\":\"appmenu\",\"pid\":%d,\"tid\":1,\"ts\":%" G_GINT64_FORMAT,
+		                       event_names[rec.event], pid, rec.time);
+
+		if (rec.duration >= 0) {
+			g_string_append_printf(json, ",\"ph\":\"X\",\"dur\":%" G_GINT64_FORMAT, rec.duration);
+		} else {
+			g_string_append(json, ",\"ph\":\"i\",\"s\":\"t\"");
+		}
+
+		g_string_append_printf(json, ",\"args\":{\"xid\":\"0x%X\"", rec.xid);
+		switch (rec.event) {
+		case APPMENU_EVENT_SWITCH_APP:
+			g_string_append_printf(json, ",\"from\":\"0x%X\"", rec.detail);
+			break;
+		case APPMENU_EVENT_ROOT_CHANGED:
+			g_string_append_printf(json, ",\"entries\":%u", rec.detail);
+			break;
+		default:
+			break;
+		}
+		g_string_append(json, "}}");
+	}
+
+	g_string_append(json, "]}");
+
+	return g_string_free(json, FALSE);
+}
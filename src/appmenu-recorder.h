@@ -0,0 +1,53 @@
+/*
+Flight recorder of the last things the registrar did.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __APPMENU_RECORDER_H__
+#define __APPMENU_RECORDER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum _AppmenuEvent AppmenuEvent;
+enum _AppmenuEvent {
+	APPMENU_EVENT_REGISTER,
+	APPMENU_EVENT_UNREGISTER,
+	APPMENU_EVENT_FOCUS_CHANGE,
+	APPMENU_EVENT_FOCUS_APPLY,
+	APPMENU_EVENT_SWITCH_APP,
+	APPMENU_EVENT_SWITCH_KEPT,
+	APPMENU_EVENT_ENTRY_ADDED,
+	APPMENU_EVENT_ENTRY_REMOVED,
+	APPMENU_EVENT_ROOT_CHANGED,
+	APPMENU_EVENT_RETRY_PING,
+	APPMENU_EVENT_LAST
+};
+
+void    appmenu_recorder_mark  (AppmenuEvent event,
+                                guint xid,
+                                guint detail);
+void    appmenu_recorder_span  (AppmenuEvent event,
+                                guint xid,
+                                guint detail,
+                                gint64 start);
+
+gchar * appmenu_recorder_dump  (guint seconds);
+
+G_END_DECLS
+
+#endif
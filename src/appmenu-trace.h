@@ -0,0 +1,50 @@
+/*
+Static tracepoints on the paths that get hit the most.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __APPMENU_TRACE_H__
+#define __APPMENU_TRACE_H__
+
+/* Built with --enable-tracepoints these are USDT probes in the
+   "ayatana_appmenu" provider, a nop until something like perf or
+   bpftrace attaches to them.  Otherwise they're nothing at all,
+   the arguments are only there for the compiler to see them used.
+   Times are in microseconds of the monotonic clock.
+
+   List them with: perf list sdt_ayatana_appmenu:* */
+
+#ifdef ENABLE_TRACEPOINTS
+
+#include <sys/sdt.h>
+
+#define APPMENU_TRACE1(name, a)        DTRACE_PROBE1(ayatana_appmenu, name, a)
+#define APPMENU_TRACE2(name, a, b)     DTRACE_PROBE2(ayatana_appmenu, name, a, b)
+#define APPMENU_TRACE3(name, a, b, c)  DTRACE_PROBE3(ayatana_appmenu, name, a, b, c)
+
+#define APPMENU_TRACE_NOW()            g_get_monotonic_time()
+
+#else
+
+#define APPMENU_TRACE1(name, a)        do { if (0) { (void)(a); } } while (0)
+#define APPMENU_TRACE2(name, a, b)     do { if (0) { (void)(a); (void)(b); } } while (0)
+#define APPMENU_TRACE3(name, a, b, c)  do { if (0) { (void)(a); (void)(b); (void)(c); } } while (0)
+
+#define APPMENU_TRACE_NOW()            ((gint64)0)
+
+#endif
+
+#endif
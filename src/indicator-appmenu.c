@@ -29,6 +29,7 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <libintl.h>
 
 #include <stdlib.h> /* exit() */
+#include <string.h>
 
 #include <X11/Xlib.h>
 #include <gdk/gdkx.h>
@@ -40,17 +41,59 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <libdbusmenu-glib/menuitem.h>
 #include <libdbusmenu-glib/client.h>
 
-#include <libbamf/bamf-matcher.h>
-
 #include "gen-application-menu-registrar.xml.h"
 #include "gen-application-menu-renderer.xml.h"
 #include "indicator-appmenu-marshal.h"
 #include "window-menu.h"
 #include "window-menu-dbusmenu.h"
 #include "window-menu-model.h"
+#include "window-props.h"
+#include "window-tracker.h"
+#include "window-tracker-bamf.h"
+#include "window-tracker-ewmh.h"
+#include "appmenu-metrics.h"
+#include "appmenu-trace.h"
+#include "appmenu-recorder.h"
 #include "dbus-shared.h"
 #include "gdk-get-func.h"
 
+#define SETTINGS_SCHEMA                   "org.ayatana.indicator.appmenu"
+#define SETTINGS_KEY_CHANGED_INTERVAL     "windows-changed-interval"
+#define SETTINGS_KEY_FOCUS_DEBOUNCE       "focus-debounce"
+#define SETTINGS_KEY_STUBS_BLACKLIST      "menu-stubs-blacklist"
+#define SETTINGS_KEY_MENU_CACHE_BUDGET    "menu-cache-budget"
+#define SETTINGS_KEY_PREFETCH_COUNT       "menu-prefetch-count"
+#define SETTINGS_KEY_WINDOW_TRACKER       "window-tracker"
+
+/* Values of the window-tracker key */
+enum {
+	TRACKER_BAMF,
+	TRACKER_EWMH
+};
+
+/* Recently focused windows that are remembered for prefetching */
+#define FOCUS_MRU_LENGTH                  16
+/* Milliseconds the focus has to stay put before prefetching */
+#define PREFETCH_DELAY                    500
+
+/* Registry snapshot for restarts, see snapshot_write() */
+#define SNAPSHOT_DIR                      "ayatana-indicator-appmenu"
+#define SNAPSHOT_VERSION                  1
+#define SNAPSHOT_TYPE                     "(ua(uyso))"
+
+enum {
+	SNAPSHOT_DBUSMENU,
+	SNAPSHOT_MODEL
+};
+
+/* Properties */
+enum {
+	PROP_0,
+	PROP_WINDOW_TRACKER
+};
+
+#define PROP_WINDOW_TRACKER_S             "window-tracker"
+
 /**********************
   Indicator Object
  **********************/
@@ -78,6 +121,10 @@ enum _ActiveStubsState {
 	STUBS_HIDE
 };
 
+typedef struct _SenderWatch SenderWatch;
+typedef struct _ShownEntry ShownEntry;
+typedef struct _IndexedEntry IndexedEntry;
+
 typedef enum _AppmenuMode AppmenuMode;
 enum _AppmenuMode {
 	MODE_STANDARD,
@@ -97,8 +144,8 @@ struct _IndicatorAppmenu {
 	WindowMenu * default_app;
 	GHashTable * apps;
 
-	BamfMatcher * matcher;
-	BamfWindow * active_window;
+	WindowTracker * tracker;
+	guint active_window;
 	ActiveStubsState active_stubs;
 
 	GtkMenuItem * close_item;
@@ -110,6 +157,95 @@ struct _IndicatorAppmenu {
 	GDBusConnection * bus;
 	guint owner_id;
 	guint dbus_registration;
+	guint metrics_registration;
+
+	/* Registry batching */
+	guint batch_depth;
+	gboolean focus_dirty;
+	guint focus_idle;
+
+	/* Registered windows by the bus name that registered them */
+	GHashTable * senders;
+	GHashTable * window_senders;
+
+	/* Focus changes waiting to settle */
+	guint pending_window;
+	gboolean focus_pending;
+	guint focus_debounce;
+	gint64 focus_time;
+	/* When the last focus change was applied, until its entries
+	   make it to the panel */
+	gint64 entries_wait;
+
+	/* Recently focused XIDs, most recent first, see prefetch_cb() */
+	GQueue * focus_mru;
+	guint prefetch_source;
+	guint prefetch_next;
+
+	/* Pending WindowsChanged signal */
+	GHashTable * changed_added;
+	GHashTable * changed_removed;
+	guint changed_source;
+
+	GSettings * settings;
+
+	/* Outstanding window property fetches */
+	GCancellable * props_cancel;
+
+	/* Entries on the panel, see ShownEntry */
+	GPtrArray * shown;
+
+	/* All the entries in unity all menus mode, see IndexedEntry */
+	GHashTable * entry_index;
+	GList * entry_snapshot;
+
+	/* Whether to show menu stubs, see show_menu_stubs() */
+	GHashTable * stubs_blacklist;
+	GHashTable * stubs_apps;
+	GHashTable * stubs_windows;
+
+	/* Menus that have been used, most recent first, see menus_evict() */
+	GQueue * menus_lru;
+
+	/* GetMenus reply, kept until the registry changes */
+	GVariant * menus_reply;
+	guint64 generation;
+
+	/* Registry snapshot from the last run */
+	GVariant * snapshot;
+	gboolean snapshot_ready;
+	guint snapshot_source;
+	GCancellable * snapshot_cancel;
+};
+
+
+/* Tracks whether an application that registered windows
+   is still on the bus */
+struct _SenderWatch {
+	IndicatorAppmenu * iapp;
+	gchar * name;
+	guint watch_id;
+	GHashTable * windows;
+};
+
+/* An entry on the panel standing in for one of the entries of the
+   current menus.  When the focus moves to another window with
+   similar menus the entry gets pointed at the new menus instead of
+   being removed and added again. */
+struct _ShownEntry {
+	IndicatorObjectEntry entry;   /* Must be first */
+	IndicatorObjectEntry * source;
+	GtkLabel * source_label;
+	gchar * accessible_desc;
+	gchar * name_hint;
+	gboolean show_now;
+};
+
+/* Where an entry lives in unity all menus mode, so that finding
+   it doesn't need a search through all the windows */
+struct _IndexedEntry {
+	WindowMenu * owner;
+	guint position;
 };
 
 
@@ -142,8 +278,24 @@ struct _IndicatorAppmenuDebug {
   Prototypes
  **********************/
 static gboolean indicator_appmenu_delayed_init                       (IndicatorAppmenu * iapp);
+static GSettings * settings_new                                      (void);
+static void load_stubs_blacklist                                     (IndicatorAppmenu * iapp);
+static void stubs_blacklist_changed                                  (GSettings * settings,
+                                                                      const gchar * key,
+                                                                      gpointer user_data);
+static void menu_cache_budget_changed                                (GSettings * settings,
+                                                                      const gchar * key,
+                                                                      gpointer user_data);
 static void indicator_appmenu_dispose                                (GObject *object);
 static void indicator_appmenu_finalize                               (GObject *object);
+static void indicator_appmenu_set_property                           (GObject * object,
+                                                                      guint prop_id,
+                                                                      const GValue * value,
+                                                                      GParamSpec * pspec);
+static void indicator_appmenu_get_property                           (GObject * object,
+                                                                      guint prop_id,
+                                                                      GValue * value,
+                                                                      GParamSpec * pspec);
 static void build_window_menus                                       (IndicatorAppmenu * iapp);
 static GList * get_entries                                           (IndicatorObject * io);
 static guint get_location                                            (IndicatorObject * io,
@@ -157,13 +309,19 @@ static void entry_activate_window                                    (IndicatorO
                                                                       guint timestamp);
 static void switch_default_app                                       (IndicatorAppmenu * iapp,
                                                                       WindowMenu * newdef,
-                                                                      BamfWindow * active_window);
+                                                                      guint active_window);
+static void menus_touch                                              (IndicatorAppmenu * iapp,
+                                                                      WindowMenu * menus);
+static void menus_evict                                              (IndicatorAppmenu * iapp);
+static void focus_mru_push                                           (IndicatorAppmenu * iapp,
+                                                                      guint xid);
+static void prefetch_schedule                                        (IndicatorAppmenu * iapp);
 static void find_relevant_windows                                    (IndicatorAppmenu * iapp);
-static void new_window                                               (BamfMatcher * matcher,
-                                                                      BamfView * view,
+static void new_window                                               (WindowTracker * tracker,
+                                                                      guint xid,
                                                                       gpointer user_data);
-static void old_window                                               (BamfMatcher * matcher,
-                                                                      BamfView * view,
+static void old_window                                               (WindowTracker * tracker,
+                                                                      guint xid,
                                                                       gpointer user_data);
 static void window_entry_added                                       (WindowMenu * mw,
                                                                       IndicatorObjectEntry * entry,
@@ -181,12 +339,13 @@ static void window_show_menu                                         (WindowMenu
 static void window_a11y_update                                       (WindowMenu * mw,
                                                                       IndicatorObjectEntry * entry,
                                                                       gpointer user_data);
-static void active_window_changed                                    (BamfMatcher * matcher,
-                                                                      BamfView * oldview,
-                                                                      BamfView * newview,
+static void active_window_changed                                    (WindowTracker * tracker,
+                                                                      guint oldxid,
+                                                                      guint newxid,
                                                                       gpointer user_data);
 static WindowMenu * update_active_window                             (IndicatorAppmenu * appmenu,
-                                                                      BamfWindow *window);
+                                                                      guint xid);
+static void cancel_pending_focus                                     (IndicatorAppmenu * iapp);
 static GQuark error_quark                                            (void);
 static void bus_method_call                                          (GDBusConnection * connection,
                                                                       const gchar * sender,
@@ -196,6 +355,13 @@ static void bus_method_call                                          (GDBusConne
                                                                       GVariant * params,
                                                                       GDBusMethodInvocation * invocation,
                                                                       gpointer user_data);
+static GVariant * bus_get_property                                   (GDBusConnection * connection,
+                                                                      const gchar * sender,
+                                                                      const gchar * object_path,
+                                                                      const gchar * interface,
+                                                                      const gchar * property,
+                                                                      GError ** error,
+                                                                      gpointer user_data);
 static void on_bus_acquired                                          (GDBusConnection * connection,
                                                                       const gchar * name,
                                                                       gpointer user_data);
@@ -203,11 +369,25 @@ static void on_name_lost                                             (GDBusConne
                                                                       const gchar * name,
                                                                       gpointer user_data);
 static WindowMenu * ensure_menus                                     (IndicatorAppmenu * iapp,
-	                                                                  BamfWindow * window);
+	                                                                  guint xid);
 static GVariant * unregister_window                                  (IndicatorAppmenu * iapp,
                                                                       guint windowid);
 static void connect_to_menu_signals                                  (IndicatorAppmenu * iapp,
 	                                                                  WindowMenu * menus);
+static void sender_index_remove                                      (IndicatorAppmenu * iapp,
+                                                                      guint windowid);
+static void sender_watch_free                                        (gpointer data);
+static void mark_focus_dirty                                         (IndicatorAppmenu * iapp);
+static GList * get_source_entries                                    (IndicatorAppmenu * iapp);
+static void sync_shown_entries                                       (IndicatorAppmenu * iapp,
+                                                                      IndicatorObjectEntry * removing);
+static ShownEntry * shown_entry_for_source                           (IndicatorAppmenu * iapp,
+                                                                      IndicatorObjectEntry * source);
+static void shown_entry_free                                         (ShownEntry * shown);
+static void snapshot_load                                            (IndicatorAppmenu * iapp);
+static void snapshot_restore                                         (IndicatorAppmenu * iapp);
+static void snapshot_queue                                           (IndicatorAppmenu * iapp);
+static gboolean snapshot_write                                       (gpointer user_data);
 
 /* Unique error codes for debug interface */
 enum {
@@ -223,7 +403,7 @@ static GDBusNodeInfo *      node_info = NULL;
 static GDBusInterfaceInfo * interface_info = NULL;
 static GDBusInterfaceVTable interface_table = {
        method_call:    bus_method_call,
-       get_property:   NULL, /* No properties */
+       get_property:   bus_get_property,
        set_property:   NULL  /* No properties */
 };
 
@@ -241,6 +421,16 @@ indicator_appmenu_class_init (IndicatorAppmenuClass *klass)
 
 	object_class->dispose = indicator_appmenu_dispose;
 	object_class->finalize = indicator_appmenu_finalize;
+	object_class->set_property = indicator_appmenu_set_property;
+	object_class->get_property = indicator_appmenu_get_property;
+
+	/* Where the windows come from, BAMF if nobody says otherwise */
+	g_object_class_install_property(object_class, PROP_WINDOW_TRACKER,
+	                                g_param_spec_object(PROP_WINDOW_TRACKER_S,
+	                                                    "Window Tracker",
+	                                                    "Follows the windows and the focus between them",
+	                                                    WINDOW_TRACKER_TYPE,
+	                                                    G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
 
 	IndicatorObjectClass * ioclass = INDICATOR_OBJECT_CLASS(klass);
 
@@ -282,9 +472,97 @@ indicator_appmenu_init (IndicatorAppmenu *self)
 	/* Setup the cache of windows with possible desktop entries */
 	self->desktop_windows = g_hash_table_new(g_direct_hash, g_direct_equal);
 
+	/* Index of who registered which windows */
+	self->senders = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, sender_watch_free);
+	self->window_senders = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	/* Window changes waiting to be signaled */
+	self->changed_added = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_variant_unref);
+	self->changed_removed = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	self->settings = settings_new();
+
+	/* Menu stub decisions */
+	self->stubs_blacklist = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	self->stubs_apps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	self->stubs_windows = g_hash_table_new(g_direct_hash, g_direct_equal);
+	load_stubs_blacklist(self);
+
+	if (self->settings != NULL) {
+		g_signal_connect(self->settings, "changed::" SETTINGS_KEY_STUBS_BLACKLIST, G_CALLBACK(stubs_blacklist_changed), self);
+		g_signal_connect(self->settings, "changed::" SETTINGS_KEY_MENU_CACHE_BUDGET, G_CALLBACK(menu_cache_budget_changed), self);
+	}
+
+	self->props_cancel = g_cancellable_new();
+	self->snapshot_cancel = g_cancellable_new();
+
+	self->shown = g_ptr_array_new();
+	self->entry_index = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	self->menus_lru = g_queue_new();
+	self->focus_mru = g_queue_new();
+
 	g_idle_add((GSourceFunc) indicator_appmenu_delayed_init, self);
 }
 
+static void
+indicator_appmenu_set_property (GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec)
+{
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(object);
+
+	switch (prop_id) {
+	case PROP_WINDOW_TRACKER:
+		g_clear_object(&iapp->tracker);
+		iapp->tracker = g_value_dup_object(value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	return;
+}
+
+static void
+indicator_appmenu_get_property (GObject * object, guint prop_id, GValue * value, GParamSpec * pspec)
+{
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(object);
+
+	switch (prop_id) {
+	case PROP_WINDOW_TRACKER:
+		g_value_set_object(value, iapp->tracker);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	return;
+}
+
+/* Only use the settings when the schema is installed, a missing
+   schema shouldn't take the whole panel down with it */
+static GSettings *
+settings_new (void)
+{
+	GSettingsSchemaSource * source = g_settings_schema_source_get_default();
+	GSettingsSchema * schema = NULL;
+	GSettings * settings = NULL;
+
+	if (source != NULL) {
+		schema = g_settings_schema_source_lookup(source, SETTINGS_SCHEMA, TRUE);
+	}
+
+	if (schema == NULL) {
+		g_warning("Settings schema '" SETTINGS_SCHEMA "' is not installed, using defaults");
+		return NULL;
+	}
+
+	settings = g_settings_new_full(schema, NULL, NULL);
+	g_settings_schema_unref(schema);
+
+	return settings;
+}
+
 /* Delayed Init, this is done so it can happen after that the mode has been set */
 static gboolean
 indicator_appmenu_delayed_init (IndicatorAppmenu *self)
@@ -301,22 +579,32 @@ indicator_appmenu_delayed_init (IndicatorAppmenu *self)
 	if (self->active_stubs != STUBS_HIDE)
 		build_window_menus(self);
 
-	/* Get the default BAMF matcher */
-	self->matcher = bamf_matcher_get_default();
-	if (self->matcher == NULL) {
-		/* we don't want to exit out of Unity -- but this
-		   should really never happen */
-		g_warning("Unable to get BAMF matcher, can not watch applications switch!");
-	} else {
-		g_signal_connect(G_OBJECT(self->matcher), "active-window-changed", G_CALLBACK(active_window_changed), self);
+	/* Follow the windows the way the settings say unless we were
+	   given something else to follow them with */
+	if (self->tracker == NULL && self->settings != NULL &&
+	    g_settings_get_enum(self->settings, SETTINGS_KEY_WINDOW_TRACKER) == TRACKER_EWMH) {
+		self->tracker = WINDOW_TRACKER(window_tracker_ewmh_new());
+
+		if (self->tracker == NULL) {
+			g_warning("Unable to follow the windows through EWMH, using BAMF");
+		}
+	}
 
-		/* Desktop window tracking */
-		g_signal_connect(G_OBJECT(self->matcher), "view-opened", G_CALLBACK(new_window), self);
-		g_signal_connect(G_OBJECT(self->matcher), "view-closed", G_CALLBACK(old_window), self);
+	if (self->tracker == NULL) {
+		self->tracker = WINDOW_TRACKER(window_tracker_bamf_new());
 	}
 
+	g_signal_connect(G_OBJECT(self->tracker), WINDOW_TRACKER_SIGNAL_ACTIVE_WINDOW_CHANGED, G_CALLBACK(active_window_changed), self);
+
+	/* Desktop window tracking */
+	g_signal_connect(G_OBJECT(self->tracker), WINDOW_TRACKER_SIGNAL_WINDOW_OPENED, G_CALLBACK(new_window), self);
+	g_signal_connect(G_OBJECT(self->tracker), WINDOW_TRACKER_SIGNAL_WINDOW_CLOSED, G_CALLBACK(old_window), self);
+
 	find_relevant_windows(self);
 
+	/* See who was registered before we got restarted */
+	snapshot_load(self);
+
 	/* Request a name so others can find us */
 	self->owner_id = g_bus_own_name (G_BUS_TYPE_SESSION,
 	                                 DBUS_NAME,
@@ -357,6 +645,14 @@ on_bus_acquired (GDBusConnection * connection, const gchar * name,
 		g_critical("Unable to register the object to DBus: %s", error->message);
 		g_error_free(error);
 	}
+
+	iapp->metrics_registration = appmenu_metrics_export(connection, &error);
+	if (error != NULL) {
+		g_warning("Unable to register the metrics to DBus: %s", error->message);
+		g_error_free(error);
+	}
+
+	snapshot_restore(iapp);
 }
 
 static void
@@ -374,7 +670,7 @@ on_name_lost (GDBusConnection * connection, const gchar * name,
 
 	/* We can rest assured no one will register with us, but let's
 	   just ensure we're not showing anything. */
-	switch_default_app(iapp, NULL, NULL);
+	switch_default_app(iapp, NULL, 0);
 }
 
 /* Object refs decrement */
@@ -389,6 +685,11 @@ indicator_appmenu_dispose (GObject *object)
 		iapp->dbus_registration = 0;
 	}
 
+	if (iapp->metrics_registration != 0) {
+		g_dbus_connection_unregister_object(iapp->bus, iapp->metrics_registration);
+		iapp->metrics_registration = 0;
+	}
+
 	g_clear_object(&iapp->bus);
 
 	if (iapp->owner_id != 0) {
@@ -396,15 +697,87 @@ indicator_appmenu_dispose (GObject *object)
 		iapp->owner_id = 0;
 	}
 
-	/* bring down the matcher before resetting to no menu so we don't
-	   get match signals */
-	g_clear_object(&iapp->matcher);
+	/* Nobody is waiting on window properties anymore */
+	if (iapp->props_cancel != NULL) {
+		g_cancellable_cancel(iapp->props_cancel);
+		g_clear_object(&iapp->props_cancel);
+	}
+
+	/* Drop focus changes that haven't been applied yet */
+	if (iapp->focus_debounce != 0) {
+		g_source_remove(iapp->focus_debounce);
+		iapp->focus_debounce = 0;
+	}
+
+	iapp->pending_window = 0;
+	iapp->focus_pending = FALSE;
+
+	if (iapp->prefetch_source != 0) {
+		g_source_remove(iapp->prefetch_source);
+		iapp->prefetch_source = 0;
+	}
+	g_clear_pointer(&iapp->focus_mru, g_queue_free);
+
+	/* bring down the tracker before resetting to no menu so we don't
+	   get window signals */
+	if (iapp->tracker != NULL) {
+		g_signal_handlers_disconnect_by_data(iapp->tracker, iapp);
+		g_clear_object(&iapp->tracker);
+	}
 
 	/* No specific ref */
-	switch_default_app(iapp, NULL, NULL);
+	switch_default_app(iapp, NULL, 0);
+
+	if (iapp->shown != NULL) {
+		g_ptr_array_foreach(iapp->shown, (GFunc)shown_entry_free, NULL);
+		g_ptr_array_free(iapp->shown, TRUE);
+		iapp->shown = NULL;
+	}
+
+	g_clear_pointer(&iapp->entry_snapshot, g_list_free);
+	g_clear_pointer(&iapp->entry_index, g_hash_table_destroy);
+	g_clear_pointer(&iapp->menus_lru, g_queue_free);
+
+	/* Get the last changes on disk for the next run */
+	if (iapp->snapshot_source != 0) {
+		g_source_remove(iapp->snapshot_source);
+		snapshot_write(iapp);
+	}
+
+	if (iapp->snapshot_cancel != NULL) {
+		g_cancellable_cancel(iapp->snapshot_cancel);
+		g_clear_object(&iapp->snapshot_cancel);
+	}
+
+	g_clear_pointer(&iapp->snapshot, g_variant_unref);
 
 	g_clear_pointer(&iapp->apps, g_hash_table_destroy);
+	g_clear_pointer(&iapp->menus_reply, g_variant_unref);
 	g_clear_pointer(&iapp->desktop_windows, g_hash_table_destroy);
+	g_clear_pointer(&iapp->window_senders, g_hash_table_destroy);
+	g_clear_pointer(&iapp->senders, g_hash_table_destroy);
+
+	if (iapp->changed_source != 0) {
+		g_source_remove(iapp->changed_source);
+		iapp->changed_source = 0;
+	}
+
+	if (iapp->focus_idle != 0) {
+		g_source_remove(iapp->focus_idle);
+		iapp->focus_idle = 0;
+	}
+
+	g_clear_pointer(&iapp->changed_added, g_hash_table_destroy);
+	g_clear_pointer(&iapp->changed_removed, g_hash_table_destroy);
+
+	if (iapp->settings != NULL) {
+		g_signal_handlers_disconnect_by_data(iapp->settings, iapp);
+		g_clear_object(&iapp->settings);
+	}
+
+	g_clear_pointer(&iapp->stubs_blacklist, g_hash_table_destroy);
+	g_clear_pointer(&iapp->stubs_apps, g_hash_table_destroy);
+	g_clear_pointer(&iapp->stubs_windows, g_hash_table_destroy);
 
 	if (iapp->desktop_menu != NULL) {
 		/* Wait, nothing here?  Yup.  We're not referencing the
@@ -435,8 +808,6 @@ indicator_appmenu_finalize (GObject *object)
 		g_array_free(iapp->window_menus, TRUE);
 	}
 
-	g_signal_handlers_disconnect_by_data(iapp->matcher, iapp);
-
 	G_OBJECT_CLASS (indicator_appmenu_parent_class)->finalize (object);
 	return;
 }
@@ -463,18 +834,93 @@ emit_signal (IndicatorAppmenu * iapp, const gchar * name, GVariant * variant)
 	return;
 }
 
+/* Send out all the registrations and removals that have been
+   collected since the last WindowsChanged signal */
+static gboolean
+emit_windows_changed (gpointer user_data)
+{
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
+	GVariantBuilder added;
+	GVariantBuilder removed;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	iapp->changed_source = 0;
+
+	if (iapp->bus != NULL) {
+		g_variant_builder_init(&added, G_VARIANT_TYPE("a(uso)"));
+		g_hash_table_iter_init(&iter, iapp->changed_added);
+		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+			g_variant_builder_add_value(&added, value);
+		}
+
+		g_variant_builder_init(&removed, G_VARIANT_TYPE("au"));
+		g_hash_table_iter_init(&iter, iapp->changed_removed);
+		while (g_hash_table_iter_next(&iter, &key, NULL)) {
+			g_variant_builder_add(&removed, "u", GPOINTER_TO_UINT(key));
+		}
+
+		emit_signal(iapp, "WindowsChanged", g_variant_new("(a(uso)au)", &added, &removed));
+	}
+
+	g_hash_table_remove_all(iapp->changed_added);
+	g_hash_table_remove_all(iapp->changed_removed);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Make sure there's a WindowsChanged signal on the way */
+static void
+schedule_windows_changed (IndicatorAppmenu * iapp)
+{
+	guint interval = 0;
+
+	if (iapp->changed_source != 0) {
+		return;
+	}
+
+	if (iapp->settings != NULL) {
+		interval = g_settings_get_uint(iapp->settings, SETTINGS_KEY_CHANGED_INTERVAL);
+	}
+
+	if (interval == 0) {
+		iapp->changed_source = g_idle_add(emit_windows_changed, iapp);
+	} else {
+		iapp->changed_source = g_timeout_add(interval, emit_windows_changed, iapp);
+	}
+}
+
+/* Collect a new registration for the next WindowsChanged signal */
+static void
+queue_window_added (IndicatorAppmenu * iapp, guint windowid, const gchar * sender, const gchar * objectpath)
+{
+	g_hash_table_insert(iapp->changed_added, GUINT_TO_POINTER(windowid),
+	                    g_variant_ref_sink(g_variant_new("(uso)", windowid, sender, objectpath)));
+	schedule_windows_changed(iapp);
+}
+
+/* Collect a removal for the next WindowsChanged signal.  If the
+   window was added in the same batch it's dropped from there too. */
+static void
+queue_window_removed (IndicatorAppmenu * iapp, guint windowid)
+{
+	g_hash_table_remove(iapp->changed_added, GUINT_TO_POINTER(windowid));
+	g_hash_table_add(iapp->changed_removed, GUINT_TO_POINTER(windowid));
+	schedule_windows_changed(iapp);
+}
+
 /* Close the current application using magic */
 static void
 close_current (GtkMenuItem * mi, gpointer user_data)
 {
 	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
 
-	if (!BAMF_IS_WINDOW (iapp->active_window) || bamf_view_is_closed (BAMF_VIEW (iapp->active_window))) {
+	if (iapp->active_window == 0 || !window_tracker_has_window(iapp->tracker, iapp->active_window)) {
 		g_warning("Can't close a window we don't have. Window is either non-existent or recently closed.");
 		return;
 	}
 
-	guint32 xid = bamf_window_get_xid(iapp->active_window);
+	guint32 xid = iapp->active_window;
 	guint timestamp = gdk_event_get_time(NULL);
 
 	XEvent xev;
@@ -561,6 +1007,7 @@ determine_new_desktop (IndicatorAppmenu * iapp)
 		if (pwm != NULL) {
 			g_debug("Setting Desktop Menus to: %X", xid);
 			iapp->desktop_menu = WINDOW_MENU(pwm);
+			window_menu_realize(iapp->desktop_menu);
 			break;
 		}
 	}
@@ -575,38 +1022,74 @@ determine_new_desktop (IndicatorAppmenu * iapp)
 static void
 find_relevant_windows (IndicatorAppmenu * iapp)
 {
-	GList * windows = bamf_matcher_get_windows(iapp->matcher);
-	GList * lwindow;
+	GArray * windows = window_tracker_get_windows(iapp->tracker);
+	guint i;
 
-	for (lwindow = windows; lwindow != NULL; lwindow = g_list_next(lwindow)) {
-		BamfView * view = BAMF_VIEW(lwindow->data);
-		new_window(iapp->matcher, view, iapp);
+	for (i = 0; i < windows->len; i++) {
+		new_window(iapp->tracker, g_array_index(windows, guint, i), iapp);
 	}
 
-	g_list_free(windows);
+	g_array_free(windows, TRUE);
 
 	return;
 }
 
-/* When new windows are born, we check to see if they're desktop
-   windows. */
+/* A window waiting on its properties before we look for menus */
+typedef struct _PropsWait PropsWait;
+struct _PropsWait {
+	IndicatorAppmenu * iapp;
+	guint xid;
+};
+
+static void
+props_wait_free (gpointer data)
+{
+	PropsWait * wait = (PropsWait *)data;
+	g_free(wait);
+	return;
+}
+
+/* The properties are in, so building the menus won't have to go
+   back to the X server */
 static void
-new_window (BamfMatcher * matcher, BamfView * view, gpointer user_data)
+new_window_props (guint xid, WindowProps * props, gpointer user_data)
 {
-	if (!BAMF_IS_WINDOW(view)) {
+	PropsWait * wait = (PropsWait *)user_data;
+
+	if (!window_tracker_has_window(wait->iapp->tracker, wait->xid)) {
 		return;
 	}
 
-	BamfWindow * window = BAMF_WINDOW(view);
+	ensure_menus(wait->iapp, wait->xid);
+	return;
+}
+
+/* When new windows are born, we check to see if they're desktop
+   windows. */
+static void
+new_window (WindowTracker * tracker, guint xid, gpointer user_data)
+{
 	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
-	guint32 xid = bamf_window_get_xid(window);
 
 	if (iapp->mode == MODE_UNITY_ALL_MENUS) {
-		ensure_menus(iapp, window);
+		PropsWait * wait = g_new0(PropsWait, 1);
+		wait->iapp = iapp;
+		wait->xid = xid;
+
+		if (xid == 0 || !window_props_fetch(xid, iapp->props_cancel, new_window_props, wait, props_wait_free)) {
+			ensure_menus(iapp, xid);
+			props_wait_free(wait);
+		}
 		return;
 	}
 
-	if (bamf_window_get_window_type(window) != BAMF_WINDOW_DESKTOP) {
+	/* Get the properties on their way so that they're around by
+	   the time the window gets focus */
+	if (xid != 0) {
+		window_props_fetch(xid, iapp->props_cancel, NULL, NULL, NULL);
+	}
+
+	if (window_tracker_get_window_type(tracker, xid) != WINDOW_TRACKER_WINDOW_DESKTOP) {
 		return;
 	}
 
@@ -618,103 +1101,168 @@ new_window (BamfMatcher * matcher, BamfView * view, gpointer user_data)
 	if (pwm != NULL) {
 		WindowMenu * wm = WINDOW_MENU(pwm);
 		iapp->desktop_menu = wm;
+		window_menu_realize(wm);
 		g_debug("Setting Desktop Menus to: %X", xid);
-		if (iapp->active_window == NULL && iapp->default_app == NULL) {
-			switch_default_app(iapp, NULL, NULL);
+		if (iapp->active_window == 0 && iapp->default_app == NULL) {
+			switch_default_app(iapp, NULL, 0);
 		}
 	}
 }
 
 /* When windows leave us, this function gets called */
 static void
-old_window (BamfMatcher * matcher, BamfView * view, gpointer user_data)
+old_window (WindowTracker * tracker, guint xid, gpointer user_data)
 {
-	if (!BAMF_IS_WINDOW(view)) {
-		return;
-	}
-
 	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
-	BamfWindow * window = BAMF_WINDOW(view);
-	guint32 xid = bamf_window_get_xid(window);
 
 	unregister_window(iapp, xid);
+	window_props_forget(xid);
+
+	if (iapp->stubs_windows != NULL) {
+		g_hash_table_remove(iapp->stubs_windows, GUINT_TO_POINTER(xid));
+	}
+
+	if (iapp->focus_mru != NULL) {
+		g_queue_remove(iapp->focus_mru, GUINT_TO_POINTER(xid));
+	}
+
+	if (iapp->pending_window == xid) {
+		iapp->pending_window = 0;
+	}
+
+	/* We're going to a state where we don't know what the active
+	   window is, hopefully the tracker will save us.  This can't wait
+	   for the focus to settle as it'd be pointing at nothing. */
+	if (iapp->active_window == xid) {
+		update_active_window(iapp, 0);
+	}
 
 	return;
 }
 
-/* List of desktop files that shouldn't have menu stubs. */
+/* List of desktop files that shouldn't have menu stubs, used
+   when the settings schema isn't installed. */
 const static gchar * stubs_blacklist[] = {
 	/* Firefox */
-	"/firefox.desktop",
+	"firefox.desktop",
 	/* Thunderbird */
-	"/thunderbird.desktop",
+	"thunderbird.desktop",
 	/* Open Office */
-	"/openoffice.org-base.desktop",
-	"/openoffice.org-impress.desktop",
-	"/openoffice.org-calc.desktop",
-	"/openoffice.org-math.desktop",
-	"/openoffice.org-draw.desktop",
-	"/openoffice.org-writer.desktop",
+	"openoffice.org-base.desktop",
+	"openoffice.org-impress.desktop",
+	"openoffice.org-calc.desktop",
+	"openoffice.org-math.desktop",
+	"openoffice.org-draw.desktop",
+	"openoffice.org-writer.desktop",
 	/* Blender */
-	"/blender-fullscreen.desktop",
-	"/blender-windowed.desktop",
+	"blender-fullscreen.desktop",
+	"blender-windowed.desktop",
 	/* Eclipse */
-	"/eclipse.desktop",
+	"eclipse.desktop",
 
 	NULL
 };
 
-/* Check with BAMF, and then check the blacklist of desktop files
-   to see if any are there.  Otherwise, show the stubs. */
-gboolean
-show_menu_stubs (BamfApplication * app)
+/* Fill the set of desktop files that shouldn't get stubs */
+static void
+load_stubs_blacklist (IndicatorAppmenu * iapp)
 {
-	if (bamf_application_get_show_menu_stubs(app) == FALSE) {
-		return FALSE;
-	}
+	gchar ** blacklist = NULL;
+	int i;
 
-	const gchar * desktop_file = bamf_application_get_desktop_file(app);
-	if (desktop_file == NULL || desktop_file[0] == '\0') {
-		return TRUE;
+	g_hash_table_remove_all(iapp->stubs_blacklist);
+
+	if (iapp->settings != NULL) {
+		blacklist = g_settings_get_strv(iapp->settings, SETTINGS_KEY_STUBS_BLACKLIST);
 	}
 
-	int i;
-	for (i = 0; stubs_blacklist[i] != NULL; i++) {
-		if (g_str_has_suffix(desktop_file, stubs_blacklist[i]) == 0) {
-			return FALSE;
+	if (blacklist != NULL) {
+		for (i = 0; blacklist[i] != NULL; i++) {
+			g_hash_table_add(iapp->stubs_blacklist, blacklist[i]);
+		}
+
+		/* The set owns the strings now */
+		g_free(blacklist);
+	} else {
+		for (i = 0; stubs_blacklist[i] != NULL; i++) {
+			g_hash_table_add(iapp->stubs_blacklist, g_strdup(stubs_blacklist[i]));
 		}
 	}
 
-	return TRUE;
+	return;
 }
 
-/* Get the current set of entries */
-static GList *
-get_entries (IndicatorObject * io)
+/* The blacklist changed, forget everything we decided with the
+   old one and take another look at the focused window */
+static void
+stubs_blacklist_changed (GSettings * settings, const gchar * key, gpointer user_data)
 {
-	g_return_val_if_fail(IS_INDICATOR_APPMENU(io), NULL);
-	IndicatorAppmenu * iapp = INDICATOR_APPMENU(io);
-	GHashTableIter iter;
-	gpointer value;
-	GList* entries = NULL;
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
 
-	if (iapp->mode == MODE_UNITY_ALL_MENUS) {
-		g_hash_table_iter_init(&iter, iapp->apps);
-		while (g_hash_table_iter_next(&iter, NULL, &value)) {
-			GList *app_entries = window_menu_get_entries(WINDOW_MENU (value));
-			entries = g_list_concat(app_entries, entries);
+	load_stubs_blacklist(iapp);
+
+	g_hash_table_remove_all(iapp->stubs_apps);
+	g_hash_table_remove_all(iapp->stubs_windows);
+
+	if (iapp->active_stubs != STUBS_UNKNOWN) {
+		iapp->active_stubs = STUBS_UNKNOWN;
+		sync_shown_entries(iapp, NULL);
+	}
+
+	return;
+}
+
+/* Check with the window's application, and then check the blacklist
+   of desktop files to see if any are there.  Otherwise, show the
+   stubs.  The answer is remembered for the desktop file. */
+static gboolean
+show_menu_stubs (IndicatorAppmenu * iapp, guint xid)
+{
+	gchar * desktop_file = window_tracker_get_desktop_file(iapp->tracker, xid);
+	gboolean has_desktop_file = (desktop_file != NULL && desktop_file[0] != '\0');
+	gpointer cached = NULL;
+
+	if (has_desktop_file && g_hash_table_lookup_extended(iapp->stubs_apps, desktop_file, NULL, &cached)) {
+		g_free(desktop_file);
+		return GPOINTER_TO_INT(cached);
+	}
+
+	gboolean show = TRUE;
+
+	if (window_tracker_get_show_menu_stubs(iapp->tracker, xid) == FALSE) {
+		show = FALSE;
+	} else if (has_desktop_file) {
+		const gchar * basename = strrchr(desktop_file, '/');
+		basename = (basename != NULL) ? basename + 1 : desktop_file;
+
+		if (g_hash_table_contains(iapp->stubs_blacklist, basename)) {
+			show = FALSE;
 		}
+	}
 
-		return entries;
+	if (has_desktop_file) {
+		g_hash_table_insert(iapp->stubs_apps, desktop_file, GINT_TO_POINTER(show));
+	} else {
+		g_free(desktop_file);
 	}
 
+	return show;
+}
+
+/* Get the entries of the menus that should be on the panel right
+   now, these are the sources for the entries that are shown. */
+static GList *
+get_source_entries (IndicatorAppmenu * iapp)
+{
+	GList* entries = NULL;
+
 	/* If we have a focused app with menus, use it's windows */
 	if (iapp->default_app != NULL) {
 		return window_menu_get_entries(iapp->default_app);
 	}
 
 	/* Else, let's go with desktop windows if there isn't a focused window */
-	if (iapp->active_window == NULL) {
+	if (iapp->active_window == 0) {
 		if (iapp->desktop_menu == NULL) {
 			return NULL;
 		} else {
@@ -725,17 +1273,23 @@ get_entries (IndicatorObject * io)
 	/* Oh, now we're looking at stubs. */
 
 	if (iapp->active_stubs == STUBS_UNKNOWN) {
-		iapp->active_stubs = STUBS_SHOW;
-
-		BamfApplication * app = bamf_matcher_get_application_for_window(iapp->matcher, iapp->active_window);
-		if (app != NULL) {
-			/* First check to see if we can find an app, then if we can
-			   check to see if it has an opinion on whether we should
-			   show the stubs or not. */
-			if (show_menu_stubs(app) == FALSE) {
+		guint xid = iapp->active_window;
+		gpointer cached = NULL;
+
+		if (g_hash_table_lookup_extended(iapp->stubs_windows, GUINT_TO_POINTER(xid), NULL, &cached)) {
+			/* We've been here before */
+			iapp->active_stubs = GPOINTER_TO_INT(cached);
+		} else {
+			iapp->active_stubs = STUBS_SHOW;
+
+			/* Check to see if the app has an opinion on whether we
+			   should show the stubs or not. */
+			if (show_menu_stubs(iapp, xid) == FALSE) {
 				/* If it blocks them, fall out. */
 				iapp->active_stubs = STUBS_HIDE;
 			}
+
+			g_hash_table_insert(iapp->stubs_windows, GUINT_TO_POINTER(xid), GINT_TO_POINTER(iapp->active_stubs));
 		}
 	}
 
@@ -754,6 +1308,57 @@ get_entries (IndicatorObject * io)
 	return entries;
 }
 
+/* Get the current set of entries */
+static GList *
+get_entries (IndicatorObject * io)
+{
+	g_return_val_if_fail(IS_INDICATOR_APPMENU(io), NULL);
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(io);
+	GList* entries = NULL;
+
+	if (iapp->mode == MODE_UNITY_ALL_MENUS) {
+		if (iapp->entry_index == NULL) {
+			return NULL;
+		}
+
+		/* The snapshot is kept until the entries change.  It's built
+		   from the windows so that each one's entries stay in order,
+		   skipping any that have already left the index. */
+		if (iapp->entry_snapshot == NULL) {
+			GHashTableIter iter;
+			gpointer value;
+
+			g_hash_table_iter_init(&iter, iapp->apps);
+			while (g_hash_table_iter_next(&iter, NULL, &value)) {
+				GList * app_entries = window_menu_get_entries(WINDOW_MENU(value));
+				GList * l;
+
+				for (l = g_list_last(app_entries); l != NULL; l = g_list_previous(l)) {
+					if (g_hash_table_contains(iapp->entry_index, l->data)) {
+						iapp->entry_snapshot = g_list_prepend(iapp->entry_snapshot, l->data);
+					}
+				}
+
+				g_list_free(app_entries);
+			}
+		}
+
+		return g_list_copy(iapp->entry_snapshot);
+	}
+
+	if (iapp->shown == NULL) {
+		return NULL;
+	}
+
+	guint i;
+	for (i = iapp->shown->len; i > 0; i--) {
+		ShownEntry * shown = g_ptr_array_index(iapp->shown, i - 1);
+		entries = g_list_prepend(entries, &shown->entry);
+	}
+
+	return entries;
+}
+
 /* Grabs the location of the entry */
 static guint
 get_location (IndicatorObject * io, IndicatorObjectEntry * entry)
@@ -762,79 +1367,293 @@ get_location (IndicatorObject * io, IndicatorObjectEntry * entry)
 	IndicatorAppmenu * iapp = INDICATOR_APPMENU(io);
 
 	if (iapp->mode == MODE_UNITY_ALL_MENUS) {
-		GHashTableIter iter;
-		gpointer value;
-
-		g_hash_table_iter_init(&iter, iapp->apps);
-		while (g_hash_table_iter_next(&iter, NULL, &value)) {
-			count = window_menu_get_location(WINDOW_MENU (value), entry);
+		IndexedEntry * indexed = NULL;
 
-			if (count != G_MAXUINT)
-				return count;
+		if (iapp->entry_index != NULL) {
+			indexed = g_hash_table_lookup(iapp->entry_index, entry);
 		}
 
+		return indexed != NULL ? indexed->position : 0;
+	}
+
+	if (iapp->shown == NULL) {
 		return 0;
 	}
 
-	if (iapp->default_app != NULL) {
-		/* Find the location in the app */
-		count = window_menu_get_location(iapp->default_app, entry);
-	} else if (iapp->active_window != NULL && iapp->window_menus) {
-		/* Find the location in the window menus */
-		for (count = 0; count < iapp->window_menus->len; count++) {
-			if (entry == &g_array_index(iapp->window_menus, IndicatorObjectEntry, count)) {
-				break;
-			}
-		}
-		if (count == iapp->window_menus->len) {
-			g_warning("Unable to find entry in default window menus");
-			count = G_MAXUINT;
-		}
-	} else {
-		/* Find the location in the desktop menu */
-		if (iapp->desktop_menu != NULL) {
-			count = window_menu_get_location(iapp->desktop_menu, entry);
+	for (count = 0; count < iapp->shown->len; count++) {
+		if (entry == g_ptr_array_index(iapp->shown, count)) {
+			return count;
 		}
 	}
 
-	return (count == G_MAXUINT) ? 0 : count;
+	g_warning("Unable to find entry in the shown menus");
+	return 0;
 }
 
-/* Responds to a menuitem being activated on the panel. */
+/* Copy over the state of the label we're standing in for */
 static void
-entry_activate (IndicatorObject * io, IndicatorObjectEntry * entry, guint timestamp)
+shown_entry_mirror (ShownEntry * shown)
 {
-	return entry_activate_window(io, entry, 0, timestamp);
+	GtkLabel * source = shown->source_label;
+	GtkLabel * label = shown->entry.label;
+
+	if (source == NULL || label == NULL) {
+		return;
+	}
+
+	gtk_label_set_use_underline(label, gtk_label_get_use_underline(source));
+	gtk_label_set_use_markup(label, gtk_label_get_use_markup(source));
+	if (g_strcmp0(gtk_label_get_label(label), gtk_label_get_label(source)) != 0) {
+		gtk_label_set_label(label, gtk_label_get_label(source));
+	}
+
+	gtk_widget_set_visible(GTK_WIDGET(label), gtk_widget_get_visible(GTK_WIDGET(source)));
+	gtk_widget_set_sensitive(GTK_WIDGET(label), gtk_widget_get_sensitive(GTK_WIDGET(source)));
+
+	return;
+}
+
+/* The source label changed, follow along */
+static void
+shown_entry_label_notify (GObject * obj, GParamSpec * pspec, gpointer user_data)
+{
+	shown_entry_mirror((ShownEntry *)user_data);
+	return;
 }
 
-/* Find the BAMF Window that is associated with that XID.  Unfortunately
-   this requires a bit of searching, don't do it too often */
-static BamfWindow *
-xid_to_bamf_window (IndicatorAppmenu * iapp, guint xid)
+/* The menu got destroyed out from under us */
+static void
+shown_entry_menu_destroyed (GtkWidget * widget, gpointer user_data)
 {
-	BamfWindow * newwindow = bamf_matcher_get_window_for_xid(iapp->matcher, xid);
+	ShownEntry * shown = (ShownEntry *)user_data;
 
-	if (BAMF_IS_WINDOW(newwindow))
-		return newwindow;
+	g_signal_handlers_disconnect_by_data(widget, shown);
+	g_clear_object(&shown->entry.menu);
 
-	BamfApplication *application = bamf_matcher_get_application_for_xid(iapp->matcher, xid);
-	GList * children = bamf_view_peek_children (BAMF_VIEW (application));
-	GList * l;
+	return;
+}
+
+/* Stop standing in for the source entry */
+static void
+shown_entry_unbind (ShownEntry * shown)
+{
+	if (shown->source_label != NULL) {
+		g_signal_handlers_disconnect_by_data(shown->source_label, shown);
+		g_clear_object(&shown->source_label);
+	}
+
+	if (shown->entry.menu != NULL) {
+		g_signal_handlers_disconnect_by_data(shown->entry.menu, shown);
+		g_clear_object(&shown->entry.menu);
+	}
+
+	g_clear_pointer(&shown->accessible_desc, g_free);
+	g_clear_pointer(&shown->name_hint, g_free);
+	shown->entry.accessible_desc = NULL;
+	shown->entry.name_hint = NULL;
+	shown->source = NULL;
+
+	return;
+}
+
+/* Point the shown entry at a source entry and pick up its state */
+static void
+shown_entry_bind (ShownEntry * shown, IndicatorObjectEntry * source)
+{
+	shown_entry_unbind(shown);
+
+	shown->source = source;
+	shown->entry.parent_window = source->parent_window;
+
+	shown->accessible_desc = g_strdup(source->accessible_desc);
+	shown->entry.accessible_desc = shown->accessible_desc;
+	shown->name_hint = g_strdup(source->name_hint);
+	shown->entry.name_hint = shown->name_hint;
+
+	if (source->menu != NULL) {
+		shown->entry.menu = g_object_ref(source->menu);
+		g_signal_connect(shown->entry.menu, "destroy", G_CALLBACK(shown_entry_menu_destroyed), shown);
+	}
+
+	if (source->label != NULL && shown->entry.label != NULL) {
+		shown->source_label = g_object_ref(source->label);
+		g_signal_connect(shown->source_label, "notify::label", G_CALLBACK(shown_entry_label_notify), shown);
+		g_signal_connect(shown->source_label, "notify::use-underline", G_CALLBACK(shown_entry_label_notify), shown);
+		g_signal_connect(shown->source_label, "notify::use-markup", G_CALLBACK(shown_entry_label_notify), shown);
+		g_signal_connect(shown->source_label, "notify::visible", G_CALLBACK(shown_entry_label_notify), shown);
+		g_signal_connect(shown->source_label, "notify::sensitive", G_CALLBACK(shown_entry_label_notify), shown);
+		shown_entry_mirror(shown);
+	}
+
+	return;
+}
+
+/* Build a new entry for the panel standing in for @source */
+static ShownEntry *
+shown_entry_new (IndicatorAppmenu * iapp, IndicatorObjectEntry * source)
+{
+	ShownEntry * shown = g_new0(ShownEntry, 1);
+
+	shown->entry.parent_object = INDICATOR_OBJECT(iapp);
+
+	if (source->label != NULL) {
+		shown->entry.label = GTK_LABEL(gtk_label_new(NULL));
+		g_object_ref_sink(shown->entry.label);
+	}
+
+	/* Images can't be followed, so entries that have them are
+	   never reused for another source */
+	if (source->image != NULL) {
+		shown->entry.image = g_object_ref(source->image);
+	}
+
+	shown_entry_bind(shown, source);
+
+	return shown;
+}
+
+static void
+shown_entry_free (ShownEntry * shown)
+{
+	shown_entry_unbind(shown);
+
+	g_clear_object(&shown->entry.label);
+	g_clear_object(&shown->entry.image);
+
+	g_free(shown);
+	return;
+}
+
+/* Whether the shown entry can stand in for @source without
+   the panel having to replace it.  Panels only attach the menu
+   when an entry is added, so the menu has to be the same one.
+   Between windows that only happens when they share their menus,
+   other windows get all of their entries replaced. */
+static gboolean
+shown_entry_can_rebind (ShownEntry * shown, IndicatorObjectEntry * source)
+{
+	return shown->entry.image == NULL && source->image == NULL &&
+	       shown->entry.label != NULL && source->label != NULL &&
+	       shown->entry.menu == source->menu;
+}
+
+/* Find the shown entry that stands in for @source */
+static ShownEntry *
+shown_entry_for_source (IndicatorAppmenu * iapp, IndicatorObjectEntry * source)
+{
+	guint i;
+
+	if (source == NULL || iapp->shown == NULL) {
+		return NULL;
+	}
+
+	for (i = 0; i < iapp->shown->len; i++) {
+		ShownEntry * shown = g_ptr_array_index(iapp->shown, i);
+
+		if (shown->source == source) {
+			return shown;
+		}
+	}
+
+	return NULL;
+}
+
+/* Bring the entries on the panel in line with the menus that should
+   be shown.  Entries are matched up by position: one with a label
+   and the same menu gets pointed at the new source and only updates
+   whatever is different on its label, so the panel doesn't have to
+   lay out the whole thing again.  That covers menus changing within
+   a window and switching between windows sharing their menus, a
+   switch to a window with menus of its own replaces them all.  Only
+   entries that can't be matched up are removed or added.  @removing
+   is an entry that's on its way out of the source menus and should
+   be ignored. */
+static void
+sync_shown_entries (IndicatorAppmenu * iapp, IndicatorObjectEntry * removing)
+{
+	if (iapp->shown == NULL || iapp->mode == MODE_UNITY_ALL_MENUS) {
+		return;
+	}
+
+	GList * sources = get_source_entries(iapp);
+	GList * lsource;
+	guint position = 0;
+	gboolean changed = FALSE;
+
+	if (removing != NULL) {
+		sources = g_list_remove(sources, removing);
+	}
+
+	for (lsource = sources; lsource != NULL; lsource = g_list_next(lsource), position++) {
+		IndicatorObjectEntry * source = lsource->data;
+		ShownEntry * shown = NULL;
+
+		if (position < iapp->shown->len) {
+			shown = g_ptr_array_index(iapp->shown, position);
+		}
 
-	for (l = children; l; l = l->next) {
-		if (!BAMF_IS_WINDOW(l->data)) {
+		if (shown != NULL && shown->source == source) {
+			/* Windows sharing menus share the entries too */
+			shown->entry.parent_window = source->parent_window;
 			continue;
 		}
 
-		BamfWindow * testwindow = BAMF_WINDOW(l->data);
+		changed = TRUE;
 
-		if (xid == bamf_window_get_xid(testwindow)) {
-			newwindow = testwindow;
-			break;
+		if (shown != NULL && shown_entry_can_rebind(shown, source)) {
+			gboolean desc_changed = g_strcmp0(shown->accessible_desc, source->accessible_desc) != 0;
+
+			if (shown->show_now) {
+				shown->show_now = FALSE;
+				g_signal_emit(G_OBJECT(iapp), INDICATOR_OBJECT_SIGNAL_SHOW_NOW_CHANGED_ID, 0, &shown->entry, FALSE);
+			}
+
+			shown_entry_bind(shown, source);
+
+			if (desc_changed) {
+				g_signal_emit_by_name(G_OBJECT(iapp), INDICATOR_OBJECT_SIGNAL_ACCESSIBLE_DESC_UPDATE, &shown->entry);
+			}
+
+			continue;
+		}
+
+		ShownEntry * replacement = shown_entry_new(iapp, source);
+
+		if (shown != NULL) {
+			g_ptr_array_index(iapp->shown, position) = replacement;
+			g_signal_emit_by_name(G_OBJECT(iapp), INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED, &shown->entry);
+			shown_entry_free(shown);
+		} else {
+			g_ptr_array_add(iapp->shown, replacement);
 		}
+
+		g_signal_emit_by_name(G_OBJECT(iapp), INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED, &replacement->entry);
+	}
+
+	g_list_free(sources);
+
+	/* Whatever is left over doesn't have anything to show */
+	while (iapp->shown->len > position) {
+		ShownEntry * shown = g_ptr_array_remove_index(iapp->shown, iapp->shown->len - 1);
+		g_signal_emit_by_name(G_OBJECT(iapp), INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED, &shown->entry);
+		shown_entry_free(shown);
+	}
+
+	/* The first entries of a newly focused window are out, menus
+	   that are still being built get here as they show up */
+	if (changed && iapp->entries_wait != 0 && iapp->shown->len > 0) {
+		appmenu_metrics_record(APPMENU_HISTOGRAM_FOCUS_LATENCY, g_get_monotonic_time() - iapp->entries_wait);
+		iapp->entries_wait = 0;
 	}
 
-	return newwindow;
+	return;
+}
+
+/* Responds to a menuitem being activated on the panel. */
+static void
+entry_activate (IndicatorObject * io, IndicatorObjectEntry * entry, guint timestamp)
+{
+	return entry_activate_window(io, entry, 0, timestamp);
 }
 
 /* Responds to a menuitem being activated on the panel. */
@@ -845,64 +1664,81 @@ entry_activate_window (IndicatorObject * io, IndicatorObjectEntry * entry, guint
 	IndicatorAppmenu * iapp = INDICATOR_APPMENU(io);
 
 	/* We need to force a focus change in this case as we probably
-	   just haven't gotten the signal from BAMF yet */
-	if (windowid != 0) {
-		BamfWindow * newwindow = xid_to_bamf_window(iapp, windowid);
-
-		if (newwindow != NULL) {
-			menus = update_active_window(iapp, newwindow);
+	   just haven't gotten the signal from the tracker yet */
+	if (windowid != 0 && window_tracker_has_window(iapp->tracker, windowid)) {
+		/* This is what the user is looking at, no reason
+		   to wait for things to settle */
+		cancel_pending_focus(iapp);
+		menus = update_active_window(iapp, windowid);
+	}
+
+	if (iapp->mode != MODE_UNITY_ALL_MENUS) {
+		/* The panel has the entry standing in for the real one */
+		ShownEntry * shown = (ShownEntry *)entry;
+		guint i;
+
+		entry = NULL;
+		for (i = 0; iapp->shown != NULL && i < iapp->shown->len; i++) {
+			if (g_ptr_array_index(iapp->shown, i) == shown) {
+				entry = shown->source;
+				break;
+			}
 		}
-	}
-
-	if (iapp->mode != MODE_UNITY_ALL_MENUS && iapp->default_app != NULL) {
-		menus = iapp->default_app;
 
-		if (!menus && iapp->active_window == NULL) {
+		menus = NULL;
+		if (iapp->default_app != NULL) {
+			menus = iapp->default_app;
+		} else if (iapp->active_window == 0) {
 			menus = iapp->desktop_menu;
 		}
 	}
 
-	if (menus) {
+	if (menus && entry) {
 		window_menu_entry_activate(menus, entry, timestamp);
 	}
 }
 
-/* Checks to see we cared about a window that's going
-   away, so that we can deal with that */
+/* Let the close item follow whether the window manager will
+   close the active window */
 static void
-window_finalized_is_active (gpointer user_data, GObject * old_window)
+update_close_item (IndicatorAppmenu * iapp, guint xid, gboolean has_functions, guint functions)
 {
-	g_return_if_fail(IS_INDICATOR_APPMENU(user_data));
-	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
+	if (!has_functions) {
+		g_debug("Unable to get MWM functions for: %d", xid);
+		functions = GDK_FUNC_ALL;
+	}
 
-	/* Pointer comparison as we can't really trust any of the
-	   pointers to do any dereferencing */
-	if ((gpointer)iapp->active_window != (gpointer)old_window) {
-		/* Ah, no issue, we weren't caring about this one
-		   anyway. */
-		return;
+	if (functions & GDK_FUNC_ALL || functions & GDK_FUNC_CLOSE) {
+		gtk_widget_set_sensitive(GTK_WIDGET(iapp->close_item), TRUE);
 	}
 
-	/* We're going to a state where we don't know what the active
-	   window is, hopefully BAMF will save us */
-	active_window_changed(iapp->matcher, NULL, NULL, iapp);
+	return;
+}
+
+/* The properties of the active window are in, the close
+   item was waiting on its hints */
+static void
+active_window_props (guint xid, WindowProps * props, gpointer user_data)
+{
+	PropsWait * wait = (PropsWait *)user_data;
+
+	if (props == NULL || wait->iapp->active_window != wait->xid || wait->iapp->close_item == NULL) {
+		return;
+	}
 
+	update_close_item(wait->iapp, wait->xid, props->has_functions, props->functions);
 	return;
 }
 
 /* A helper for switch_default_app that takes care of the
    switching of the active window variable */
 static void
-switch_active_window (IndicatorAppmenu * iapp, BamfWindow * active_window)
+switch_active_window (IndicatorAppmenu * iapp, guint active_window)
 {
 	if (iapp->active_window == active_window || iapp->mode == MODE_UNITY_ALL_MENUS) {
 		return;
 	}
 
-	if (iapp->active_window != NULL) {
-		g_object_weak_unref(G_OBJECT(iapp->active_window), window_finalized_is_active, iapp);
-	}
-
 	iapp->active_window = active_window;
 
 	if (iapp->mode == MODE_STANDARD)
@@ -911,10 +1747,6 @@ switch_active_window (IndicatorAppmenu * iapp, BamfWindow * active_window)
 	/* Close any existing open menu by showing a null entry */
 	window_show_menu(iapp->default_app, NULL, gtk_get_current_event_time(), iapp);
 
-	if (active_window != NULL) {
-		g_object_weak_ref(G_OBJECT(active_window), window_finalized_is_active, iapp);
-	}
-
 	if (iapp->close_item == NULL) {
 		g_warning("No close item!?!?!");
 		return;
@@ -922,25 +1754,33 @@ switch_active_window (IndicatorAppmenu * iapp, BamfWindow * active_window)
 
 	gtk_widget_set_sensitive(GTK_WIDGET(iapp->close_item), FALSE);
 
-	if (iapp->active_window == NULL) {
+	guint32 xid = iapp->active_window;
+	if (xid == 0 || !window_tracker_has_window(iapp->tracker, xid)) {
 		return;
 	}
 
-	guint32 xid = bamf_window_get_xid(iapp->active_window);
-	if (xid == 0 || bamf_view_is_closed (BAMF_VIEW (iapp->active_window))) {
+	/* The hints come along with the menu properties, which are
+	   read when the window shows up and dropped when they change */
+	WindowProps * props = window_props_lookup(xid);
+	if (props != NULL) {
+		update_close_item(iapp, xid, props->has_functions, props->functions);
 		return;
 	}
 
-	GdkWMFunction functions;
-	if (!egg_xid_get_functions(xid, &functions)) {
-		g_debug("Unable to get MWM functions for: %d", xid);
-		functions = GDK_FUNC_ALL;
-	}
+	PropsWait * wait = g_new0(PropsWait, 1);
+	wait->iapp = iapp;
+	wait->xid = xid;
 
-	if (functions & GDK_FUNC_ALL || functions & GDK_FUNC_CLOSE) {
-		gtk_widget_set_sensitive(GTK_WIDGET(iapp->close_item), TRUE);
+	if (window_props_fetch(xid, iapp->props_cancel, active_window_props, wait, props_wait_free)) {
+		return;
 	}
 
+	props_wait_free(wait);
+
+	GdkWMFunction functions = 0;
+	gboolean has_functions = egg_xid_get_functions(xid, &functions);
+	update_close_item(iapp, xid, has_functions, functions);
+
 	return;
 }
 
@@ -975,7 +1815,7 @@ connect_to_menu_signals (IndicatorAppmenu * iapp, WindowMenu * menus)
 /* Switch applications, remove all the entires for the previous
    one and add them for the new application */
 static void
-switch_default_app (IndicatorAppmenu * iapp, WindowMenu * newdef, BamfWindow * active_window)
+switch_default_app (IndicatorAppmenu * iapp, WindowMenu * newdef, guint active_window)
 {
 	if (iapp->mode == MODE_UNITY_ALL_MENUS) {
 		return;
@@ -987,17 +1827,23 @@ switch_default_app (IndicatorAppmenu * iapp, WindowMenu * newdef, BamfWindow * a
 		/* Keep active window up-to-date, though we're probably not
 		   using it much. */
 		switch_active_window(iapp, active_window);
+		appmenu_recorder_mark(APPMENU_EVENT_SWITCH_KEPT, window_menu_get_xid(newdef), 0);
+
+		/* Nothing goes out to the panel, so there's nothing to time */
+		iapp->entries_wait = 0;
 		return;
 	}
 
 	if (iapp->default_app == NULL && iapp->active_window == active_window && newdef == NULL) {
 		/* There's no application menus, but the active window hasn't
-		   changed.  So there's no change. */
+		   changed.  The desktop menus might have though. */
+		sync_shown_entries(iapp, NULL);
 		return;
 	}
 
-	/* hide the entries that we're swapping out */
-	indicator_object_set_visible (INDICATOR_OBJECT(iapp), FALSE);
+	gint64 start = g_get_monotonic_time();
+	guint oldxid = iapp->default_app != NULL ? window_menu_get_xid(iapp->default_app) : 0;
+	guint newxid = newdef != NULL ? window_menu_get_xid(newdef) : 0;
 
 	if (iapp->default_app)
 	{
@@ -1008,7 +1854,7 @@ switch_default_app (IndicatorAppmenu * iapp, WindowMenu * newdef, BamfWindow * a
 		iapp->default_app = NULL;
 	}
 
-	/* Update the active window pointer -- may be NULL */
+	/* Update the active window pointer -- may be zero */
 	switch_active_window(iapp, active_window);
 
 	/* If we're putting up a new window, let's do that now. */
@@ -1016,10 +1862,27 @@ switch_default_app (IndicatorAppmenu * iapp, WindowMenu * newdef, BamfWindow * a
 		/* Switch */
 		iapp->default_app = newdef;
 		connect_to_menu_signals(iapp, iapp->default_app);
+
+		/* Registered menus wait until they're first used before
+		   building anything, entries signal as they show up */
+		menus_touch(iapp, iapp->default_app);
+		window_menu_realize(iapp->default_app);
+	}
+
+	/* Menus shared with other windows need to be pointed back
+	   at the one they're shown for */
+	if (iapp->default_app != NULL) {
+		window_menu_focus(iapp->default_app);
+	} else if (iapp->active_window == 0 && iapp->desktop_menu != NULL) {
+		window_menu_focus(iapp->desktop_menu);
 	}
 
-	/* show the entries that we're swapping in */
-	indicator_object_set_visible (INDICATOR_OBJECT(iapp), TRUE);
+	/* Only touch the entries on the panel that are different */
+	sync_shown_entries(iapp, NULL);
+
+	/* The old menus are off the panel now, they can go if
+	   they've fallen too far behind */
+	menus_evict(iapp);
 
 	/* Set up initial state for new entries if needed */
 	if (iapp->default_app != NULL &&
@@ -1029,15 +1892,105 @@ switch_default_app (IndicatorAppmenu * iapp, WindowMenu * newdef, BamfWindow * a
 		                      iapp);
 	}
 
+	appmenu_recorder_span(APPMENU_EVENT_SWITCH_APP, newxid, oldxid, start);
+	APPMENU_TRACE3(switch_default_app, oldxid, newxid, g_get_monotonic_time() - start);
+
+	return;
+}
+
+/* Move the menus to the front of the recently used list */
+static void
+menus_touch (IndicatorAppmenu * iapp, WindowMenu * menus)
+{
+	if (iapp->menus_lru == NULL) {
+		return;
+	}
+
+	GList * link = g_queue_find(iapp->menus_lru, menus);
+	if (link != NULL) {
+		g_queue_unlink(iapp->menus_lru, link);
+		g_queue_push_head_link(iapp->menus_lru, link);
+	} else {
+		g_queue_push_head(iapp->menus_lru, menus);
+	}
+
+	return;
+}
+
+/* The budget for realized menus in bytes, zero when there's no limit */
+static gsize
+menus_budget (IndicatorAppmenu * iapp)
+{
+	return (gsize)g_settings_get_uint(iapp->settings, SETTINGS_KEY_MENU_CACHE_BUDGET) * 1024;
+}
+
+/* Menus of windows that haven't been used in a while go back to
+   the state they were registered in, which is just enough to
+   build them again when the window gets focus.  The most recently
+   used ones are kept until their estimated size fills the budget.
+   In unity all menus mode every window has its menus shown, so
+   nothing goes. */
+static void
+menus_evict (IndicatorAppmenu * iapp)
+{
+	if (iapp->mode == MODE_UNITY_ALL_MENUS || iapp->settings == NULL || iapp->menus_lru == NULL) {
+		return;
+	}
+
+	gsize budget = menus_budget(iapp);
+	if (budget == 0) {
+		return;
+	}
+
+	gsize used = 0;
+	GList * link;
+	for (link = g_queue_peek_head_link(iapp->menus_lru); link != NULL; link = g_list_next(link)) {
+		WindowMenu * menus = WINDOW_MENU(link->data);
+
+		if (!window_menu_is_realized(menus)) {
+			continue;
+		}
+
+		gsize size = window_menu_get_size(menus);
+
+		/* The shown menus stay whatever they cost */
+		if (menus == iapp->default_app || menus == iapp->desktop_menu || used + size <= budget) {
+			used += size;
+			continue;
+		}
+
+		g_debug("Evicting menus for %X, %" G_GSIZE_FORMAT " bytes over the budget", window_menu_get_xid(menus), used + size - budget);
+		window_menu_unrealize(menus);
+	}
+
+	return;
+}
+
+/* Someone wants a different amount of menus around */
+static void
+menu_cache_budget_changed (GSettings * settings, const gchar * key, gpointer user_data)
+{
+	menus_evict(INDICATOR_APPMENU(user_data));
 	return;
 }
 
+/* The set of registered menus changed, whatever we told people
+   before isn't right anymore */
+static void
+registry_changed (IndicatorAppmenu * iapp)
+{
+	g_clear_pointer(&iapp->menus_reply, g_variant_unref);
+	iapp->generation++;
+	snapshot_queue(iapp);
+}
+
 static void
 track_menus (IndicatorAppmenu * iapp, guint xid, WindowMenu * menus)
 {
 	g_return_if_fail(IS_WINDOW_MENU(menus));
 
 	g_hash_table_insert(iapp->apps, GUINT_TO_POINTER(xid), menus);
+	registry_changed(iapp);
 
 	if (iapp->mode == MODE_UNITY_ALL_MENUS) {
 		GList *entries, *l;
@@ -1060,26 +2013,32 @@ track_menus (IndicatorAppmenu * iapp, guint xid, WindowMenu * menus)
 }
 
 static WindowMenu *
-ensure_menus (IndicatorAppmenu * iapp, BamfWindow * window)
+ensure_menus (IndicatorAppmenu * iapp, guint xid)
 {
 	WindowMenu * menus = NULL;
-	guint32 xid = 0;
-
-	while (window != NULL && menus == NULL) {
-		xid = bamf_window_get_xid(window);
 
+	while (xid != 0 && menus == NULL) {
 		menus = g_hash_table_lookup(iapp->apps, GUINT_TO_POINTER(xid));
 
 		/* First look to see if we can get these from the
-		   GMenuModel access */
+		   GMenuModel access, if the properties were fetched
+		   already there's no need to ask the X server again */
 		if (menus == NULL) {
-			gchar * uniquename = bamf_window_get_utf8_prop (window, "_GTK_UNIQUE_BUS_NAME");
+			WindowProps * props = window_props_lookup(xid);
+			gchar * uniquename = NULL;
 
-			if (uniquename != NULL) {
-				BamfApplication * app = bamf_matcher_get_application_for_window(iapp->matcher, window);
+			if (props != NULL) {
+				uniquename = g_strdup(props->unique_bus_name);
+			} else {
+				uniquename = window_tracker_get_window_prop(iapp->tracker, xid, "_GTK_UNIQUE_BUS_NAME");
+			}
 
-				menus = WINDOW_MENU(window_menu_model_new(app, window));
-				track_menus(iapp, xid, menus);
+			if (uniquename != NULL) {
+				/* All the menus are shown at once in unity all menus mode */
+				menus = WINDOW_MENU(window_menu_model_new(iapp->tracker, xid, props, iapp->mode != MODE_UNITY_ALL_MENUS));
+				if (menus != NULL) {
+					track_menus(iapp, xid, menus);
+				}
 			}
 
 			g_free(uniquename);
@@ -1087,89 +2046,310 @@ ensure_menus (IndicatorAppmenu * iapp, BamfWindow * window)
 
 		if (menus == NULL) {
 			g_debug("Looking for parent window on XID %d", xid);
-			window = bamf_window_get_transient(window);
+			xid = window_tracker_get_transient(iapp->tracker, xid);
 		}
 	}
 
 	return menus;
 }
 
-/* Recieve the signal that the window being shown
-   has now changed. */
+/* Switch to the last focus change that we got, all the ones
+   before it never made it to the panel */
 static void
-active_window_changed (BamfMatcher * matcher, BamfView * oldview, BamfView * newview, gpointer user_data)
+apply_pending_focus (IndicatorAppmenu * iapp)
 {
-	update_active_window(INDICATOR_APPMENU(user_data), (BamfWindow *) newview);
-}
+	if (!iapp->focus_pending) {
+		return;
+	}
 
-static WindowMenu *
-update_active_window (IndicatorAppmenu * appmenu, BamfWindow *window)
-{
-	WindowMenu * menus = NULL;
+	guint xid = iapp->pending_window;
+	iapp->pending_window = 0;
+	iapp->focus_pending = FALSE;
 
-	if (window != NULL) {
-		if (!BAMF_IS_WINDOW(window)) {
-			window = NULL;
-			g_warning("Active window changed to View thats not a window.");
-		}
-	} else {
-		g_debug("Active window is: NULL");
-	}
+	g_debug("Applying focus change, %u of %u focus changes skipped so far",
+	        appmenu_metrics_get(APPMENU_COUNTER_FOCUS_ELIDED),
+	        appmenu_metrics_get(APPMENU_COUNTER_FOCUS_CHANGES));
 
-	if (appmenu->mode == MODE_UNITY_ALL_MENUS) {
-		if (window != NULL) {
-			menus = ensure_menus(appmenu, window);
-		}
-		return menus;
+	/* The latency is taken once the entries are on the panel, see
+	   sync_shown_entries(), and all menus mode doesn't switch any */
+	if (iapp->mode != MODE_UNITY_ALL_MENUS) {
+		iapp->entries_wait = g_get_monotonic_time();
 	}
 
-	if (window != NULL && bamf_window_get_window_type(window) == BAMF_WINDOW_DESKTOP) {
-		g_debug("Switching to menus from desktop");
-		switch_default_app(appmenu, NULL, NULL);
-		return menus;
-	}
+	update_active_window(iapp, xid);
 
-	g_debug("Switching to menus from XID %d", window ? bamf_window_get_xid(window) : 0);
-	menus = ensure_menus(appmenu, window);
-	switch_default_app(appmenu, menus, window);
+	appmenu_recorder_span(APPMENU_EVENT_FOCUS_APPLY, xid, 0, iapp->focus_time);
+}
 
-	return menus;
+/* The focus has settled down, show it */
+static gboolean
+focus_debounce_cb (gpointer user_data)
+{
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
+
+	iapp->focus_debounce = 0;
+	apply_pending_focus(iapp);
+
+	return G_SOURCE_REMOVE;
 }
 
-/* Respond to the menus being destroyed.  We need to deregister
-   and make sure we weren't being shown.  */
+/* Forget about any focus change that is waiting to be applied
+   because we've got a better idea of what's focused */
 static void
-menus_destroyed (IndicatorAppmenu * iapp, guint windowid)
+cancel_pending_focus (IndicatorAppmenu * iapp)
 {
-	gboolean reload_menus = FALSE;
-	WindowMenu * wm = g_hash_table_lookup(iapp->apps, GUINT_TO_POINTER(windowid));
-	g_return_if_fail (IS_WINDOW_MENU(wm));
+	if (iapp->focus_debounce != 0) {
+		g_source_remove(iapp->focus_debounce);
+		iapp->focus_debounce = 0;
+	}
 
-	g_hash_table_steal(iapp->apps, GUINT_TO_POINTER(windowid));
-	g_signal_handlers_disconnect_by_data(wm, iapp);
+	if (iapp->focus_pending) {
+		appmenu_metrics_count(APPMENU_COUNTER_FOCUS_ELIDED);
+		iapp->focus_pending = FALSE;
+	}
 
-	g_debug("Removing menus for %d", windowid);
+	iapp->pending_window = 0;
+}
 
-	if (iapp->desktop_menu == wm) {
-		iapp->desktop_menu = NULL;
-		determine_new_desktop(iapp);
-		if (iapp->default_app == NULL && iapp->active_window == NULL) {
-			reload_menus = TRUE;
-		}
+/* Remember that @xid got the focus */
+static void
+focus_mru_push (IndicatorAppmenu * iapp, guint xid)
+{
+	if (xid == 0 || iapp->focus_mru == NULL) {
+		return;
 	}
 
-	/* If we're it, let's remove ourselves and BAMF will probably
-	   give us a new entry in a bit. */
-	if (iapp->default_app == wm) {
-		reload_menus = TRUE;
-	}
+	g_queue_remove(iapp->focus_mru, GUINT_TO_POINTER(xid));
+	g_queue_push_head(iapp->focus_mru, GUINT_TO_POINTER(xid));
 
-	if (reload_menus) {
-		switch_default_app(iapp, NULL, NULL);
+	while (g_queue_get_length(iapp->focus_mru) > FOCUS_MRU_LENGTH) {
+		g_queue_pop_tail(iapp->focus_mru);
 	}
 
-	if (iapp->mode == MODE_UNITY_ALL_MENUS) {
-		GList * entries, * l;
+	return;
+}
+
+/* Whether the menu budget has room for menus nobody asked for */
+static gboolean
+prefetch_has_room (IndicatorAppmenu * iapp)
+{
+	gsize budget = menus_budget(iapp);
+	gsize used = 0;
+	GList * link;
+
+	if (budget == 0) {
+		return TRUE;
+	}
+
+	for (link = g_queue_peek_head_link(iapp->menus_lru); link != NULL; link = g_list_next(link)) {
+		used += window_menu_get_size(WINDOW_MENU(link->data));
+	}
+
+	return used < budget;
+}
+
+/* Get the menus of @xid built, they go into the recently used
+   list where the window is in the focus order so that they're
+   evicted like they would have been if they were focused */
+static void
+prefetch_window (IndicatorAppmenu * iapp, guint xid, guint position)
+{
+	WindowMenu * menus = g_hash_table_lookup(iapp->apps, GUINT_TO_POINTER(xid));
+
+	if (menus == NULL && window_tracker_has_window(iapp->tracker, xid)) {
+		menus = ensure_menus(iapp, xid);
+	}
+
+	if (menus == NULL || window_menu_is_realized(menus)) {
+		return;
+	}
+
+	g_debug("Prefetching menus for %X", xid);
+
+	g_queue_remove(iapp->menus_lru, menus);
+	g_queue_push_nth(iapp->menus_lru, menus, position);
+	window_menu_realize(menus);
+
+	return;
+}
+
+/* Warm up the menus of the windows that were focused most recently,
+   one window each time through so that focus changes don't wait */
+static gboolean
+prefetch_cb (gpointer user_data)
+{
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
+	guint count = g_settings_get_uint(iapp->settings, SETTINGS_KEY_PREFETCH_COUNT);
+
+	/* The first one is the focused window, that's taken care of */
+	if (iapp->prefetch_next > count || !prefetch_has_room(iapp)) {
+		iapp->prefetch_source = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	guint xid = GPOINTER_TO_UINT(g_queue_peek_nth(iapp->focus_mru, iapp->prefetch_next));
+	if (xid == 0) {
+		iapp->prefetch_source = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	prefetch_window(iapp, xid, iapp->prefetch_next);
+	iapp->prefetch_next++;
+
+	return G_SOURCE_CONTINUE;
+}
+
+/* Start prefetching over once the focus stops moving, someone
+   switching windows is busy enough without us */
+static void
+prefetch_schedule (IndicatorAppmenu * iapp)
+{
+	if (iapp->prefetch_source != 0) {
+		g_source_remove(iapp->prefetch_source);
+		iapp->prefetch_source = 0;
+	}
+
+	if (iapp->settings == NULL || iapp->focus_mru == NULL ||
+	    g_settings_get_uint(iapp->settings, SETTINGS_KEY_PREFETCH_COUNT) == 0) {
+		return;
+	}
+
+	iapp->prefetch_next = 1;
+	iapp->prefetch_source = g_timeout_add_full(G_PRIORITY_LOW, PREFETCH_DELAY, prefetch_cb, iapp, NULL);
+
+	return;
+}
+
+/* Recieve the signal that the window being shown
+   has now changed.  We only remember it here, and switch once
+   the focus has stopped moving around. */
+static void
+active_window_changed (WindowTracker * tracker, guint oldxid, guint newxid, gpointer user_data)
+{
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
+	guint debounce = 0;
+
+	appmenu_metrics_count(APPMENU_COUNTER_FOCUS_CHANGES);
+	iapp->focus_time = g_get_monotonic_time();
+	appmenu_recorder_mark(APPMENU_EVENT_FOCUS_CHANGE, newxid, 0);
+
+	if (iapp->focus_pending) {
+		/* The previous one never got shown */
+		appmenu_metrics_count(APPMENU_COUNTER_FOCUS_ELIDED);
+	}
+
+	iapp->pending_window = newxid;
+	iapp->focus_pending = TRUE;
+
+	focus_mru_push(iapp, newxid);
+	prefetch_schedule(iapp);
+
+	if (iapp->settings != NULL) {
+		debounce = g_settings_get_uint(iapp->settings, SETTINGS_KEY_FOCUS_DEBOUNCE);
+	}
+
+	if (debounce == 0) {
+		/* Just wait for the events that are already queued up,
+		   switching before the next frame gets drawn */
+		if (iapp->focus_debounce == 0) {
+			iapp->focus_debounce = g_idle_add_full(GDK_PRIORITY_REDRAW - 1, focus_debounce_cb, iapp, NULL);
+		}
+	} else {
+		/* Restart the quiet period */
+		if (iapp->focus_debounce != 0) {
+			g_source_remove(iapp->focus_debounce);
+		}
+		iapp->focus_debounce = g_timeout_add(debounce, focus_debounce_cb, iapp);
+	}
+}
+
+static WindowMenu *
+update_active_window (IndicatorAppmenu * appmenu, guint xid)
+{
+	WindowMenu * menus = NULL;
+
+	/* We're looking at the focus right now, so any pending update
+	   from registry changes that are already done can be skipped */
+	if (appmenu->batch_depth == 0) {
+		appmenu->focus_dirty = FALSE;
+	}
+
+	if (xid == 0) {
+		g_debug("Active window is: NULL");
+	}
+
+	if (appmenu->mode == MODE_UNITY_ALL_MENUS) {
+		if (xid != 0) {
+			menus = ensure_menus(appmenu, xid);
+		}
+		if (menus != NULL) {
+			window_menu_realize(menus);
+		}
+		return menus;
+	}
+
+	if (xid != 0 && window_tracker_get_window_type(appmenu->tracker, xid) == WINDOW_TRACKER_WINDOW_DESKTOP) {
+		g_debug("Switching to menus from desktop");
+		switch_default_app(appmenu, NULL, 0);
+		return menus;
+	}
+
+	gint64 start = APPMENU_TRACE_NOW();
+
+	menus = ensure_menus(appmenu, xid);
+	switch_default_app(appmenu, menus, xid);
+
+	APPMENU_TRACE2(update_active_window, xid, APPMENU_TRACE_NOW() - start);
+
+	return menus;
+}
+
+/* Respond to the menus being destroyed.  We need to deregister
+   and make sure we weren't being shown.  */
+static void
+menus_destroyed (IndicatorAppmenu * iapp, guint windowid)
+{
+	gboolean reload_menus = FALSE;
+	WindowMenu * wm = g_hash_table_lookup(iapp->apps, GUINT_TO_POINTER(windowid));
+	g_return_if_fail (IS_WINDOW_MENU(wm));
+
+	g_hash_table_steal(iapp->apps, GUINT_TO_POINTER(windowid));
+	registry_changed(iapp);
+	appmenu_metrics_count(APPMENU_COUNTER_UNREGISTRATIONS);
+	g_signal_handlers_disconnect_by_data(wm, iapp);
+	if (iapp->menus_lru != NULL) {
+		g_queue_remove(iapp->menus_lru, wm);
+	}
+	sender_index_remove(iapp, windowid);
+
+	g_debug("Removing menus for %d", windowid);
+
+	if (iapp->desktop_menu == wm) {
+		iapp->desktop_menu = NULL;
+		determine_new_desktop(iapp);
+		if (iapp->default_app == NULL && iapp->active_window == 0) {
+			reload_menus = TRUE;
+		}
+	}
+
+	/* If we're it, let's remove ourselves and the tracker will probably
+	   give us a new entry in a bit. */
+	if (iapp->default_app == wm) {
+		reload_menus = TRUE;
+	}
+
+	if (reload_menus) {
+		switch_default_app(iapp, NULL, 0);
+
+		/* If there are more changes coming, look for the new
+		   menus once they're all done */
+		if (iapp->batch_depth > 0) {
+			mark_focus_dirty(iapp);
+		}
+	}
+
+	if (iapp->mode == MODE_UNITY_ALL_MENUS) {
+		GList * entries, * l;
 		entries = window_menu_get_entries(wm);
 		for (l = entries; l; l = l->next) {
 			window_entry_removed(wm, l->data, iapp);
@@ -1180,30 +2360,184 @@ menus_destroyed (IndicatorAppmenu * iapp, guint windowid)
 	g_object_unref(wm);
 }
 
-/* A new window wishes to register it's windows with us */
-static GVariant *
-register_window (IndicatorAppmenu * iapp, guint windowid, const gchar * objectpath,
-                 const gchar * sender)
+/* Start a set of registry changes.  The focused window is only
+   looked at again once the outermost batch is finished. */
+static void
+registry_batch_begin (IndicatorAppmenu * iapp)
+{
+	iapp->batch_depth++;
+}
+
+/* Look at the focused window again now that the registry has
+   settled down.  This happens at a low priority so that a burst of
+   registrations only results in a single update of the panel. */
+static gboolean
+focus_idle_cb (gpointer user_data)
+{
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
+
+	iapp->focus_idle = 0;
+
+	if (!iapp->focus_dirty) {
+		/* Someone already got to it */
+		return G_SOURCE_REMOVE;
+	}
+
+	iapp->focus_dirty = FALSE;
+
+	update_active_window(iapp, window_tracker_get_active_window(iapp->tracker));
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Note that the registry changed in a way that could change the
+   menus for the focused window.  They get updated once any open
+   batch is finished and the main loop is idle. */
+static void
+mark_focus_dirty (IndicatorAppmenu * iapp)
+{
+	iapp->focus_dirty = TRUE;
+
+	if (iapp->batch_depth > 0 || iapp->focus_idle != 0) {
+		return;
+	}
+
+	iapp->focus_idle = g_idle_add_full(G_PRIORITY_LOW, focus_idle_cb, iapp, NULL);
+}
+
+/* Finish a set of registry changes, scheduling an update of the
+   menus for the focused window if any of the changes asked for it. */
+static void
+registry_batch_end (IndicatorAppmenu * iapp)
+{
+	g_return_if_fail(iapp->batch_depth > 0);
+
+	iapp->batch_depth--;
+
+	if (iapp->batch_depth > 0 || !iapp->focus_dirty) {
+		return;
+	}
+
+	mark_focus_dirty(iapp);
+}
+
+/* Free the watch on a sender when it no longer has windows */
+static void
+sender_watch_free (gpointer data)
+{
+	SenderWatch * watch = (SenderWatch *)data;
+
+	if (watch->watch_id != 0) {
+		g_bus_unwatch_name(watch->watch_id);
+	}
+
+	g_hash_table_destroy(watch->windows);
+	g_free(watch->name);
+	g_free(watch);
+}
+
+/* The application that registered these windows has left the
+   bus, so none of its menus are going to work anymore.  Take them
+   all down together. */
+static void
+sender_vanished (GDBusConnection * connection, const gchar * name, gpointer user_data)
+{
+	SenderWatch * watch = (SenderWatch *)user_data;
+	IndicatorAppmenu * iapp = watch->iapp;
+	GList * xids = g_hash_table_get_keys(watch->windows);
+	GList * l;
+
+	g_debug("%s left the bus, removing %u windows", name, g_list_length(xids));
+
+	/* Careful, the watch gets free'd with the last window */
+	registry_batch_begin(iapp);
+	for (l = xids; l != NULL; l = g_list_next(l)) {
+		unregister_window(iapp, GPOINTER_TO_UINT(l->data));
+	}
+	registry_batch_end(iapp);
+
+	g_list_free(xids);
+}
+
+/* Remember which bus name registered a window, and start watching
+   that name if it's new to us */
+static void
+sender_index_add (IndicatorAppmenu * iapp, guint windowid, const gchar * sender)
+{
+	SenderWatch * watch = g_hash_table_lookup(iapp->senders, sender);
+
+	if (watch == NULL) {
+		watch = g_new0(SenderWatch, 1);
+		watch->iapp = iapp;
+		watch->name = g_strdup(sender);
+		watch->windows = g_hash_table_new(g_direct_hash, g_direct_equal);
+		g_hash_table_insert(iapp->senders, watch->name, watch);
+
+		if (iapp->bus != NULL) {
+			watch->watch_id = g_bus_watch_name_on_connection(iapp->bus,
+			                                                 sender,
+			                                                 G_BUS_NAME_WATCHER_FLAGS_NONE,
+			                                                 NULL,
+			                                                 sender_vanished,
+			                                                 watch,
+			                                                 NULL);
+		}
+	}
+
+	g_hash_table_add(watch->windows, GUINT_TO_POINTER(windowid));
+	g_hash_table_insert(iapp->window_senders, GUINT_TO_POINTER(windowid), watch);
+}
+
+/* Forget about who registered a window, dropping the watch on
+   the sender along with its last window */
+static void
+sender_index_remove (IndicatorAppmenu * iapp, guint windowid)
 {
-	g_debug("Registering window ID %d with path %s from %s", windowid, objectpath, sender);
+	SenderWatch * watch = g_hash_table_lookup(iapp->window_senders, GUINT_TO_POINTER(windowid));
+
+	if (watch == NULL) {
+		return;
+	}
+
+	g_hash_table_remove(iapp->window_senders, GUINT_TO_POINTER(windowid));
+	g_hash_table_remove(watch->windows, GUINT_TO_POINTER(windowid));
+
+	if (g_hash_table_size(watch->windows) == 0) {
+		g_hash_table_remove(iapp->senders, watch->name);
+	}
+}
+
+/* Adds a window to the registry, the caller is responsible for
+   having a batch open so the focus gets updated. */
+static void
+add_window_registration (IndicatorAppmenu * iapp, guint windowid, const gchar * objectpath,
+                         const gchar * sender)
+{
+	gint64 start = APPMENU_TRACE_NOW();
 
 	if (g_hash_table_lookup(iapp->apps, GUINT_TO_POINTER(windowid)) == NULL && windowid != 0) {
-		WindowMenu * wm = WINDOW_MENU(window_menu_dbusmenu_new(windowid, sender, objectpath));
-		g_return_val_if_fail(wm != NULL, FALSE);
+		/* All the menus are shown at once in unity all menus mode,
+		   and a submenu can only be on the panel once */
+		WindowMenu * wm = WINDOW_MENU(window_menu_dbusmenu_new(windowid, sender, objectpath, iapp->mode != MODE_UNITY_ALL_MENUS));
+		g_return_if_fail(wm != NULL);
 
 		track_menus(iapp, windowid, wm);
+		sender_index_add(iapp, windowid, sender);
+		appmenu_metrics_count(APPMENU_COUNTER_REGISTRATIONS);
+		appmenu_recorder_mark(APPMENU_EVENT_REGISTER, windowid, 0);
 
 		emit_signal(iapp, "WindowRegistered",
 		            g_variant_new("(uso)", windowid, sender, objectpath));
+		queue_window_added(iapp, windowid, sender, objectpath);
 
 		gpointer pdesktop = g_hash_table_lookup(iapp->desktop_windows, GUINT_TO_POINTER(windowid));
 		if (pdesktop != NULL) {
 			determine_new_desktop(iapp);
 		}
 
-		/* Note: Does not cause ref */
-		BamfWindow * win = bamf_matcher_get_active_window(iapp->matcher);
-		update_active_window(iapp, win);
+		mark_focus_dirty(iapp);
+
+		APPMENU_TRACE2(register_window, windowid, APPMENU_TRACE_NOW() - start);
 	} else {
 		if (windowid == 0) {
 			g_warning("Can't build windows for a NULL window ID %d with path %s from %s", windowid, objectpath, sender);
@@ -1217,31 +2551,305 @@ register_window (IndicatorAppmenu * iapp, guint windowid, const gchar * objectpa
 			   we're not going to end up infinitely recursive otherwise things
 			   could go really bad. */
 			if (g_hash_table_lookup(iapp->apps, GUINT_TO_POINTER(windowid)) == NULL) {
-				return register_window(iapp, windowid, objectpath, sender);
+				add_window_registration(iapp, windowid, objectpath, sender);
+				return;
 			}
 
 			g_warning("Unable to unregister window!");
 		}
 	}
+}
+
+/* A new window wishes to register it's windows with us */
+static GVariant *
+register_window (IndicatorAppmenu * iapp, guint windowid, const gchar * objectpath,
+                 const gchar * sender)
+{
+	registry_batch_begin(iapp);
+	add_window_registration(iapp, windowid, objectpath, sender);
+	registry_batch_end(iapp);
+
+	return g_variant_new("()");
+}
+
+/* An application wants to register a bunch of windows at once,
+   so we only need to figure out the focus once for all of them */
+static GVariant *
+register_windows (IndicatorAppmenu * iapp, GVariant * windows, const gchar * sender)
+{
+	GVariantIter iter;
+	guint32 xid;
+	const gchar * path;
+
+	g_debug("Registering %" G_GSIZE_FORMAT " windows from %s", g_variant_n_children(windows), sender);
+
+	registry_batch_begin(iapp);
+
+	g_variant_iter_init(&iter, windows);
+	while (g_variant_iter_next(&iter, "(u&o)", &xid, &path)) {
+		add_window_registration(iapp, xid, path, sender);
+	}
+
+	registry_batch_end(iapp);
 
 	return g_variant_new("()");
 }
 
+/* Where the registry gets saved, per display as that's what the
+   window IDs are valid for */
+static gchar *
+snapshot_path (void)
+{
+	GdkDisplay * display = gdk_display_get_default();
+	gchar * display_name = g_strdup(display != NULL ? gdk_display_get_name(display) : "");
+	g_strcanon(display_name, G_CSET_a_2_z G_CSET_A_2_Z G_CSET_DIGITS, '_');
+
+	gchar * filename = g_strdup_printf("registry-%s", display_name);
+	gchar * path = g_build_filename(g_get_user_runtime_dir(), SNAPSHOT_DIR, filename, NULL);
+
+	g_free(filename);
+	g_free(display_name);
+
+	return path;
+}
+
+/* Save the registry so that if we get restarted we can pick the
+   menus back up without waiting on the applications.  It's a
+   serialized GVariant so that reading it back is just a mapping
+   of the file. */
+static gboolean
+snapshot_write (gpointer user_data)
+{
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
+	GVariantBuilder builder;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	iapp->snapshot_source = 0;
+
+	if (iapp->apps == NULL) {
+		return G_SOURCE_REMOVE;
+	}
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a(uyso)"));
+	g_hash_table_iter_init(&iter, iapp->apps);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		guint xid = GPOINTER_TO_UINT(key);
+
+		if (IS_WINDOW_MENU_DBUSMENU(value)) {
+			gchar * address = window_menu_dbusmenu_get_address(WINDOW_MENU_DBUSMENU(value));
+			gchar * path = window_menu_dbusmenu_get_path(WINDOW_MENU_DBUSMENU(value));
+
+			if (address != NULL && path != NULL) {
+				g_variant_builder_add(&builder, "(uyso)", xid, SNAPSHOT_DBUSMENU, address, path);
+			}
+
+			g_free(path);
+			g_free(address);
+		} else {
+			g_variant_builder_add(&builder, "(uyso)", xid, SNAPSHOT_MODEL, "", "/");
+		}
+	}
+
+	GVariant * snapshot = g_variant_ref_sink(g_variant_new(SNAPSHOT_TYPE, SNAPSHOT_VERSION, &builder));
+	gchar * path = snapshot_path();
+	gchar * dir = g_path_get_dirname(path);
+	GError * error = NULL;
+
+	if (g_mkdir_with_parents(dir, 0700) != 0) {
+		g_warning("Unable to create directory '%s' for the registry snapshot", dir);
+	} else if (!g_file_set_contents(path, g_variant_get_data(snapshot), g_variant_get_size(snapshot), &error)) {
+		g_warning("Unable to write registry snapshot: %s", error->message);
+		g_error_free(error);
+	}
+
+	g_free(dir);
+	g_free(path);
+	g_variant_unref(snapshot);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* The registry changed, save it when things are quiet */
+static void
+snapshot_queue (IndicatorAppmenu * iapp)
+{
+	/* Don't overwrite the last one until we've had a look at it */
+	if (!iapp->snapshot_ready || iapp->snapshot_source != 0) {
+		return;
+	}
+
+	iapp->snapshot_source = g_idle_add_full(G_PRIORITY_LOW, snapshot_write, iapp, NULL);
+}
+
+/* Map the snapshot from the last run, it gets used once we're
+   on the bus and can check who's still around */
+static void
+snapshot_load (IndicatorAppmenu * iapp)
+{
+	gchar * path = snapshot_path();
+	GMappedFile * mapped = g_mapped_file_new(path, FALSE, NULL);
+
+	g_free(path);
+
+	if (mapped == NULL) {
+		iapp->snapshot_ready = TRUE;
+		return;
+	}
+
+	GBytes * bytes = g_mapped_file_get_bytes(mapped);
+	GVariant * snapshot = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(SNAPSHOT_TYPE), bytes, FALSE));
+	guint32 version = 0;
+
+	g_bytes_unref(bytes);
+	g_mapped_file_unref(mapped);
+
+	g_variant_get_child(snapshot, 0, "u", &version);
+	if (version != SNAPSHOT_VERSION) {
+		g_debug("Ignoring registry snapshot with version %u", version);
+		g_variant_unref(snapshot);
+		iapp->snapshot_ready = TRUE;
+		return;
+	}
+
+	iapp->snapshot = snapshot;
+	return;
+}
+
+/* Got the names on the bus, register the windows that are still
+   around and whose applications are still on the bus */
+static void
+snapshot_names_cb (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+	GError * error = NULL;
+	GVariant * reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+
+	if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free(error);
+		return;
+	}
+
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
+	GVariant * snapshot = iapp->snapshot;
+
+	iapp->snapshot = NULL;
+	iapp->snapshot_ready = TRUE;
+
+	if (error != NULL) {
+		g_warning("Unable to list the names on the bus, not restoring menus: %s", error->message);
+		g_error_free(error);
+		g_variant_unref(snapshot);
+		snapshot_queue(iapp);
+		return;
+	}
+
+	GVariant * namesv = g_variant_get_child_value(reply, 0);
+	const gchar ** names = g_variant_get_strv(namesv, NULL);
+	GHashTable * alive = g_hash_table_new(g_str_hash, g_str_equal);
+	GVariant * records = g_variant_get_child_value(snapshot, 1);
+	GVariantIter iter;
+	guint32 xid;
+	guchar type;
+	const gchar * sender;
+	const gchar * path;
+	guint restored = 0;
+	int i;
+
+	for (i = 0; names[i] != NULL; i++) {
+		g_hash_table_add(alive, (gpointer)names[i]);
+	}
+
+	registry_batch_begin(iapp);
+
+	g_variant_iter_init(&iter, records);
+	while (g_variant_iter_next(&iter, "(uy&s&o)", &xid, &type, &sender, &path)) {
+		/* GMenuModel windows get found through the tracker again */
+		if (type != SNAPSHOT_DBUSMENU) {
+			continue;
+		}
+
+		if (!g_hash_table_contains(alive, sender)) {
+			continue;
+		}
+
+		if (!window_tracker_has_window(iapp->tracker, xid)) {
+			continue;
+		}
+
+		/* The application beat us to it */
+		if (g_hash_table_contains(iapp->apps, GUINT_TO_POINTER(xid))) {
+			continue;
+		}
+
+		add_window_registration(iapp, xid, path, sender);
+		restored++;
+	}
+
+	registry_batch_end(iapp);
+
+	g_debug("Restored %u windows from the registry snapshot", restored);
+
+	g_variant_unref(records);
+	g_hash_table_destroy(alive);
+	g_free(names);
+	g_variant_unref(namesv);
+	g_variant_unref(reply);
+	g_variant_unref(snapshot);
+
+	/* Drop whatever didn't make it */
+	snapshot_queue(iapp);
+
+	return;
+}
+
+/* Check the snapshot against the bus with a single call */
+static void
+snapshot_restore (IndicatorAppmenu * iapp)
+{
+	if (iapp->snapshot == NULL) {
+		iapp->snapshot_ready = TRUE;
+		return;
+	}
+
+	g_dbus_connection_call(iapp->bus,
+	                       "org.freedesktop.DBus",
+	                       "/org/freedesktop/DBus",
+	                       "org.freedesktop.DBus",
+	                       "ListNames",
+	                       NULL,
+	                       G_VARIANT_TYPE("(as)"),
+	                       G_DBUS_CALL_FLAGS_NONE,
+	                       -1,
+	                       iapp->snapshot_cancel,
+	                       snapshot_names_cb,
+	                       iapp);
+
+	return;
+}
+
 /* Kindly remove an entry from our DB */
 static GVariant *
 unregister_window (IndicatorAppmenu * iapp, guint windowid)
 {
-	g_debug("Unregistering: %d", windowid);
 	g_return_val_if_fail(IS_INDICATOR_APPMENU(iapp), NULL);
-	g_return_val_if_fail(iapp->matcher != NULL, NULL);
+	g_return_val_if_fail(iapp->tracker != NULL, NULL);
+
+	gint64 start = APPMENU_TRACE_NOW();
+	appmenu_recorder_mark(APPMENU_EVENT_UNREGISTER, windowid, 0);
 
 	/* If it's a desktop window remove it from that table as well */
 	g_hash_table_remove(iapp->desktop_windows, GUINT_TO_POINTER(windowid));
 
 	emit_signal(iapp, "WindowUnregistered", g_variant_new ("(u)", windowid));
 
+	if (g_hash_table_contains(iapp->apps, GUINT_TO_POINTER(windowid))) {
+		queue_window_removed(iapp, windowid);
+	}
+
 	menus_destroyed(iapp, windowid);
 
+	APPMENU_TRACE2(unregister_window, windowid, APPMENU_TRACE_NOW() - start);
+
 	return NULL;
 }
 
@@ -1262,6 +2870,10 @@ get_menu_for_window (IndicatorAppmenu * iapp, guint windowid, GError ** error)
 		return NULL;
 	}
 
+	/* Someone is about to look at them */
+	menus_touch(iapp, wm);
+	window_menu_realize(wm);
+
 	GVariantBuilder builder;
 	g_variant_builder_init(&builder, G_VARIANT_TYPE_TUPLE);
 
@@ -1280,6 +2892,28 @@ get_menu_for_window (IndicatorAppmenu * iapp, guint windowid, GError ** error)
 	return g_variant_builder_end(&builder);
 }
 
+/* Adds the window ID, service and object path of the menus
+   to an a(uso) builder */
+static void
+add_menu_info (GVariantBuilder * builder, WindowMenu * wm)
+{
+	if (IS_WINDOW_MENU_DBUSMENU(wm)) {
+		gchar * address = window_menu_dbusmenu_get_address(WINDOW_MENU_DBUSMENU(wm));
+		gchar * path = window_menu_dbusmenu_get_path(WINDOW_MENU_DBUSMENU(wm));
+		g_variant_builder_add (builder, "(uso)",
+		                       window_menu_get_xid(wm),
+		                       address,
+		                       path);
+		g_free(path);
+		g_free(address);
+	} else {
+		g_variant_builder_add (builder, "(uso)",
+		                       window_menu_get_xid(wm),
+		                       "",
+		                       "/");
+	}
+}
+
 /* Get all the menus we have */
 static GVariant *
 get_menus (IndicatorAppmenu * iapp, GError ** error)
@@ -1289,6 +2923,11 @@ get_menus (IndicatorAppmenu * iapp, GError ** error)
 		return NULL;
 	}
 
+	/* Nothing changed since the last time, same answer */
+	if (iapp->menus_reply != NULL) {
+		return iapp->menus_reply;
+	}
+
 	GVariantBuilder builder;
 	GHashTableIter hash_iter;
 	gpointer value;
@@ -1297,22 +2936,39 @@ get_menus (IndicatorAppmenu * iapp, GError ** error)
 	g_hash_table_iter_init (&hash_iter, iapp->apps);
 	while (g_hash_table_iter_next (&hash_iter, NULL, &value)) {
 		if (value != NULL) {
-			WindowMenu * wm = WINDOW_MENU(value);
-			if (IS_WINDOW_MENU_DBUSMENU(wm)) {
-				gchar * address = window_menu_dbusmenu_get_address(WINDOW_MENU_DBUSMENU(wm));
-				gchar * path = window_menu_dbusmenu_get_path(WINDOW_MENU_DBUSMENU(wm));
-				g_variant_builder_add (&builder, "(uso)",
-				                       window_menu_get_xid(wm),
-				                       address,
-				                       path);
-				g_free(path);
-				g_free(address);
-			} else {
-				g_variant_builder_add (&builder, "(uso)",
-				                       window_menu_get_xid(wm),
-				                       "",
-				                       "/");
-			}
+			add_menu_info(&builder, WINDOW_MENU(value));
+		}
+	}
+
+	/* Not floating, so the reply doesn't take it from us */
+	iapp->menus_reply = g_variant_ref_sink(g_variant_new ("(a(uso))", &builder));
+
+	return iapp->menus_reply;
+}
+
+/* Get the menus for a set of windows, skipping the ones we
+   don't know about */
+static GVariant *
+get_menus_for_windows (IndicatorAppmenu * iapp, GVariant * windowids)
+{
+	GVariantBuilder builder;
+	GVariantIter iter;
+	guint32 xid;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE("a(uso)"));
+
+	g_variant_iter_init(&iter, windowids);
+	while (g_variant_iter_next(&iter, "u", &xid)) {
+		WindowMenu * wm = NULL;
+
+		if (xid == 0) {
+			wm = iapp->default_app;
+		} else {
+			wm = g_hash_table_lookup(iapp->apps, GUINT_TO_POINTER(xid));
+		}
+
+		if (wm != NULL) {
+			add_menu_info(&builder, wm);
 		}
 	}
 
@@ -1336,6 +2992,10 @@ bus_method_call (GDBusConnection * connection, const gchar * sender,
 		const gchar * path;
 		g_variant_get(params, "(u&o)", &xid, &path);
 		retval = register_window(iapp, xid, path, sender);
+	} else if (g_strcmp0(method, "RegisterWindows") == 0) {
+		GVariant * windows = g_variant_get_child_value(params, 0);
+		retval = register_windows(iapp, windows, sender);
+		g_variant_unref(windows);
 	} else if (g_strcmp0(method, "UnregisterWindow") == 0) {
 		guint32 xid;
 		g_variant_get(params, "(u)", &xid);
@@ -1346,6 +3006,10 @@ bus_method_call (GDBusConnection * connection, const gchar * sender,
 		retval = get_menu_for_window(iapp, xid, &error);
 	} else if (g_strcmp0(method, "GetMenus") == 0) {
 		retval = get_menus(iapp, &error);
+	} else if (g_strcmp0(method, "GetMenusForWindows") == 0) {
+		GVariant * xids = g_variant_get_child_value(params, 0);
+		retval = get_menus_for_windows(iapp, xids);
+		g_variant_unref(xids);
 	} else {
 		g_warning("Calling method '%s' on the indicator service and it's unknown", method);
 	}
@@ -1361,10 +3025,95 @@ bus_method_call (GDBusConnection * connection, const gchar * sender,
 	return;
 }
 
+/* Properties on the registrar interface */
+static GVariant *
+bus_get_property (GDBusConnection * connection, const gchar * sender,
+                  const gchar * object_path, const gchar * interface,
+                  const gchar * property, GError ** error,
+                  gpointer user_data)
+{
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
+
+	if (g_strcmp0(property, "Generation") == 0) {
+		return g_variant_new_uint64(iapp->generation);
+	}
+
+	g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY, "Unknown property '%s'", property);
+	return NULL;
+}
+
+/* Recalculate the positions of the entries of a window after
+   one of them has been added or removed, @removing is ignored */
+static void
+entry_index_renumber (IndicatorAppmenu * iapp, WindowMenu * mw, IndicatorObjectEntry * removing)
+{
+	GList * entries = window_menu_get_entries(mw);
+	GList * l;
+	guint position = 0;
+
+	for (l = entries; l != NULL; l = g_list_next(l)) {
+		if (l->data == removing) {
+			continue;
+		}
+
+		IndexedEntry * indexed = g_hash_table_lookup(iapp->entry_index, l->data);
+		if (indexed != NULL && indexed->owner == mw) {
+			indexed->position = position;
+		}
+
+		position++;
+	}
+
+	g_list_free(entries);
+	return;
+}
+
+/* Put a new entry in the index of all the entries */
+static void
+entry_index_add (IndicatorAppmenu * iapp, WindowMenu * mw, IndicatorObjectEntry * entry)
+{
+	if (iapp->entry_index == NULL) {
+		return;
+	}
+
+	IndexedEntry * indexed = g_new0(IndexedEntry, 1);
+	indexed->owner = mw;
+	g_hash_table_insert(iapp->entry_index, entry, indexed);
+	g_clear_pointer(&iapp->entry_snapshot, g_list_free);
+
+	entry_index_renumber(iapp, mw, NULL);
+	return;
+}
+
+/* Take an entry that's going away out of the index */
+static void
+entry_index_remove (IndicatorAppmenu * iapp, WindowMenu * mw, IndicatorObjectEntry * entry)
+{
+	if (iapp->entry_index == NULL) {
+		return;
+	}
+
+	if (!g_hash_table_remove(iapp->entry_index, entry)) {
+		return;
+	}
+
+	g_clear_pointer(&iapp->entry_snapshot, g_list_free);
+
+	entry_index_renumber(iapp, mw, entry);
+	return;
+}
+
 /* Pass up the entry added event */
 static void
 window_entry_added (WindowMenu * mw, IndicatorObjectEntry * entry, IndicatorAppmenu * iapp)
 {
+	if (iapp->mode != MODE_UNITY_ALL_MENUS) {
+		sync_shown_entries(iapp, NULL);
+		return;
+	}
+
+	entry_index_add(iapp, mw, entry);
+
 	entry->parent_object = INDICATOR_OBJECT(iapp);
 	g_signal_emit_by_name(G_OBJECT(iapp), INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED, entry);
 }
@@ -1373,6 +3122,13 @@ window_entry_added (WindowMenu * mw, IndicatorObjectEntry * entry, IndicatorAppm
 static void
 window_entry_removed (WindowMenu * mw, IndicatorObjectEntry * entry, IndicatorAppmenu * iapp)
 {
+	if (iapp->mode != MODE_UNITY_ALL_MENUS) {
+		sync_shown_entries(iapp, entry);
+		return;
+	}
+
+	entry_index_remove(iapp, mw, entry);
+
 	entry->parent_object = INDICATOR_OBJECT(iapp);
 	g_signal_emit_by_name(G_OBJECT(iapp), INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED, entry);
 }
@@ -1386,6 +3142,16 @@ window_status_changed (WindowMenu * mw, DbusmenuStatus status, IndicatorAppmenu
 
 	for (l = window_entries; l; l = l->next) {
 		IndicatorObjectEntry * entry = l->data;
+
+		if (iapp->mode != MODE_UNITY_ALL_MENUS) {
+			ShownEntry * shown = shown_entry_for_source(iapp, entry);
+			if (shown == NULL) {
+				continue;
+			}
+			shown->show_now = show_now;
+			entry = &shown->entry;
+		}
+
 		g_signal_emit(G_OBJECT(iapp), INDICATOR_OBJECT_SIGNAL_SHOW_NOW_CHANGED_ID, 0, entry, show_now);
 	}
 	g_list_free (window_entries);
@@ -1395,6 +3161,16 @@ window_status_changed (WindowMenu * mw, DbusmenuStatus status, IndicatorAppmenu
 static void
 window_show_menu (WindowMenu * mw, IndicatorObjectEntry * entry, guint timestamp, gpointer user_data)
 {
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
+
+	if (entry != NULL && iapp->mode != MODE_UNITY_ALL_MENUS) {
+		ShownEntry * shown = shown_entry_for_source(iapp, entry);
+		if (shown == NULL) {
+			return;
+		}
+		entry = &shown->entry;
+	}
+
 	g_signal_emit_by_name(G_OBJECT(user_data), INDICATOR_OBJECT_SIGNAL_MENU_SHOW, entry, timestamp);
 }
 
@@ -1402,6 +3178,20 @@ window_show_menu (WindowMenu * mw, IndicatorObjectEntry * entry, guint timestamp
 static void
 window_a11y_update (WindowMenu * mw, IndicatorObjectEntry * entry, gpointer user_data)
 {
+	IndicatorAppmenu * iapp = INDICATOR_APPMENU(user_data);
+
+	if (iapp->mode != MODE_UNITY_ALL_MENUS) {
+		ShownEntry * shown = shown_entry_for_source(iapp, entry);
+		if (shown == NULL) {
+			return;
+		}
+
+		g_free(shown->accessible_desc);
+		shown->accessible_desc = g_strdup(entry->accessible_desc);
+		shown->entry.accessible_desc = shown->accessible_desc;
+		entry = &shown->entry;
+	}
+
 	g_signal_emit_by_name(G_OBJECT(user_data), INDICATOR_OBJECT_SIGNAL_ACCESSIBLE_DESC_UPDATE, entry);
 }
 
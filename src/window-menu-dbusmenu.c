@@ -31,12 +31,17 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "window-menu-dbusmenu.h"
 #include "indicator-appmenu-marshal.h"
+#include "appmenu-metrics.h"
+#include "appmenu-trace.h"
+#include "appmenu-recorder.h"
 
 /* Private parts */
 
 typedef struct _WindowMenuDbusmenuPrivate WindowMenuDbusmenuPrivate;
 struct _WindowMenuDbusmenuPrivate {
 	guint windowid;
+	gchar * dbus_addr;
+	gchar * dbus_object;
 	DbusmenuGtkClient * client;
 	DbusmenuMenuitem * root;
 	GCancellable * props_cancel;
@@ -44,6 +49,8 @@ struct _WindowMenuDbusmenuPrivate {
 	GArray * entries;
 	gboolean error_state;
 	guint   retry_timer;
+	guint   root_serial;
+	gboolean share;
 };
 
 typedef struct _WMEntry WMEntry;
@@ -56,12 +63,26 @@ struct _WMEntry {
 	GVariant * vaccessible_desc;
 };
 
+/* Waiting on the first child of a root item to be realized */
+typedef struct _ChildWait ChildWait;
+struct _ChildWait {
+	GWeakRef wm;
+	DbusmenuMenuitem * newentry;
+	guint root_serial;
+};
+
 #define WINDOW_MENU_DBUSMENU_GET_PRIVATE(o) \
 (G_TYPE_INSTANCE_GET_PRIVATE ((o), WINDOW_MENU_DBUSMENU_TYPE, WindowMenuDbusmenuPrivate))
 
+/* Clients by the address and path of the menus they mirror, some
+   applications register several windows on the same menus.  These
+   aren't refs, the clients drop out of the table when they go. */
+static GHashTable * shared_clients = NULL;
+
 /* Prototypes */
 
 static void window_menu_dbusmenu_dispose    (GObject *object);
+static void window_menu_dbusmenu_finalize   (GObject *object);
 static void root_changed            (DbusmenuClient * client, DbusmenuMenuitem * new_root, gpointer user_data);
 static void event_status            (DbusmenuClient * client, DbusmenuMenuitem * mi, gchar * event, GVariant * evdata, guint timestamp, GError * error, gpointer user_data);
 static void item_activate           (DbusmenuClient * client, DbusmenuMenuitem * item, guint timestamp, gpointer user_data);
@@ -80,6 +101,10 @@ static gboolean         get_error_state  (WindowMenu * wm);
 static WindowMenuStatus get_status       (WindowMenu * wm);
 static void             entry_restore    (WindowMenu * wm, IndicatorObjectEntry * entry);
 static void             entry_activate   (WindowMenu * wm, IndicatorObjectEntry * entry, guint timestamp);
+static void             realize          (WindowMenu * wm);
+static void             unrealize        (WindowMenu * wm);
+static gboolean         is_realized      (WindowMenu * wm);
+static gsize            get_size         (WindowMenu * wm);
 
 G_DEFINE_TYPE (WindowMenuDbusmenu, window_menu_dbusmenu, WINDOW_MENU_TYPE);
 
@@ -92,6 +117,7 @@ window_menu_dbusmenu_class_init (WindowMenuDbusmenuClass *klass)
 	g_type_class_add_private (klass, sizeof (WindowMenuDbusmenuPrivate));
 
 	object_class->dispose = window_menu_dbusmenu_dispose;
+	object_class->finalize = window_menu_dbusmenu_finalize;
 
 	WindowMenuClass * menu_class = WINDOW_MENU_CLASS(klass);
 	menu_class->get_entries = get_entries;
@@ -101,6 +127,10 @@ window_menu_dbusmenu_class_init (WindowMenuDbusmenuClass *klass)
 	menu_class->get_status = get_status;
 	menu_class->entry_restore = entry_restore;
 	menu_class->entry_activate = entry_activate;
+	menu_class->realize = realize;
+	menu_class->unrealize = unrealize;
+	menu_class->is_realized = is_realized;
+	menu_class->get_size = get_size;
 
 	return;
 }
@@ -111,6 +141,8 @@ window_menu_dbusmenu_init (WindowMenuDbusmenu *self)
 {
 	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(self);
 
+	priv->dbus_addr = NULL;
+	priv->dbus_object = NULL;
 	priv->client = NULL;
 	priv->props_cancel = NULL;
 	priv->props = NULL;
@@ -119,6 +151,8 @@ window_menu_dbusmenu_init (WindowMenuDbusmenu *self)
 
 	priv->entries = g_array_new(FALSE, FALSE, sizeof(WMEntry *));
 
+	appmenu_metrics_add(APPMENU_COUNTER_WINDOWS_DBUSMENU, 1);
+
 	return;
 }
 
@@ -170,6 +204,7 @@ free_entries(GObject *object, gboolean should_signal)
 			entry = g_array_index(priv->entries, IndicatorObjectEntry *, 0);
 			g_array_remove_index(priv->entries, 0);
 			if (should_signal) {
+				appmenu_recorder_mark(APPMENU_EVENT_ENTRY_REMOVED, priv->windowid, 0);
 				g_signal_emit_by_name(object, WINDOW_MENU_SIGNAL_ENTRY_REMOVED, entry, TRUE);
 			}
 			entry_free(entry);
@@ -221,15 +256,34 @@ window_menu_dbusmenu_dispose (GObject *object)
 	return;
 }
 
+/* Free the strings */
+static void
+window_menu_dbusmenu_finalize (GObject *object)
+{
+	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(object);
+
+	g_free(priv->dbus_addr);
+	g_free(priv->dbus_object);
+
+	appmenu_metrics_add(APPMENU_COUNTER_WINDOWS_DBUSMENU, -1);
+
+	G_OBJECT_CLASS (window_menu_dbusmenu_parent_class)->finalize (object);
+	return;
+}
+
 /* Retry the event sending to the server to see if we can get things
    working again. */
 static gboolean
 retry_event (gpointer user_data)
 {
-	g_debug("Retrying event");
 	g_return_val_if_fail(IS_WINDOW_MENU_DBUSMENU(user_data), FALSE);
 	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(user_data);
 
+	APPMENU_TRACE1(retry_event, priv->windowid);
+	appmenu_recorder_mark(APPMENU_EVENT_RETRY_PING, priv->windowid, 0);
+
+	appmenu_metrics_count(APPMENU_COUNTER_RETRY_PINGS);
+
 	dbusmenu_menuitem_handle_event(dbusmenu_client_get_root(DBUSMENU_CLIENT(priv->client)),
 	                               "x-appmenu-retry-ping",
 	                               NULL,
@@ -359,13 +413,21 @@ get_status (WindowMenu * wm)
 	g_return_val_if_fail(IS_WINDOW_MENU_DBUSMENU(wm), DBUSMENU_STATUS_NORMAL);
 	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(wm);
 
+	if (priv->client == NULL) {
+		return WINDOW_MENU_STATUS_NORMAL;
+	}
+
 	return dbusmenu_status_table[dbusmenu_client_get_status (DBUSMENU_CLIENT (priv->client))];
 }
 
-/* Build a new window menus object and attach to the signals to build
-   up the representative menu. */
+/* Build a new window menus object.  This only records where the menus
+   live, the client that mirrors them is built on realize so that
+   windows which are never focused don't cost a full menu tree.  With
+   @share the client is shared with other windows on the same menus,
+   which hands them the same submenus, so only do that when no two of
+   them are shown at once. */
 WindowMenuDbusmenu *
-window_menu_dbusmenu_new (const guint windowid, const gchar * dbus_addr, const gchar * dbus_object)
+window_menu_dbusmenu_new (const guint windowid, const gchar * dbus_addr, const gchar * dbus_object, gboolean share)
 {
 	g_debug("Creating new windows menu: %X, %s, %s", windowid, dbus_addr, dbus_object);
 
@@ -377,36 +439,198 @@ window_menu_dbusmenu_new (const guint windowid, const gchar * dbus_addr, const g
 	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(newmenu);
 
 	priv->windowid = windowid;
+	priv->dbus_addr = g_strdup(dbus_addr);
+	priv->dbus_object = g_strdup(dbus_object);
+	priv->share = share;
+
+	return newmenu;
+}
+
+/* The client is gone, take it out of the table */
+static void
+shared_client_gone (gpointer data, GObject * where_the_object_was)
+{
+	gchar * key = (gchar *)data;
+
+	if (shared_clients != NULL) {
+		g_hash_table_remove(shared_clients, key);
+	}
+
+	g_free(key);
+	return;
+}
+
+/* Build a client of our own for the menus at @dbus_addr and @dbus_object */
+static DbusmenuGtkClient *
+client_new (const gchar * dbus_addr, const gchar * dbus_object)
+{
+	DbusmenuGtkClient * client = dbusmenu_gtkclient_new((gchar *)dbus_addr, (gchar *)dbus_object);
+
+	GtkAccelGroup * agroup = gtk_accel_group_new();
+	dbusmenu_gtkclient_set_accel_group(client, agroup);
+	g_object_unref(agroup);
+
+	return client;
+}
+
+/* Get a client for the menus at @dbus_addr and @dbus_object, sharing
+   the one other windows already have if there is one.  The caller owns
+   a ref on the client. */
+static DbusmenuGtkClient *
+shared_client_get (const gchar * dbus_addr, const gchar * dbus_object)
+{
+	if (shared_clients == NULL) {
+		shared_clients = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	}
+
+	/* Bus names can't have a slash and paths start with one, so
+	   putting them together keeps them apart */
+	gchar * key = g_strconcat(dbus_addr, dbus_object, NULL);
+
+	DbusmenuGtkClient * client = g_hash_table_lookup(shared_clients, key);
+	if (client != NULL) {
+		g_debug("Sharing menus client for %s %s", dbus_addr, dbus_object);
+		g_free(key);
+		return g_object_ref(client);
+	}
+
+	client = client_new(dbus_addr, dbus_object);
+
+	g_hash_table_insert(shared_clients, g_strdup(key), client);
+	g_object_weak_ref(G_OBJECT(client), shared_client_gone, key);
+
+	return client;
+}
+
+/* Attach to the signals to build up the representative menu */
+static void
+realize (WindowMenu * wm)
+{
+	g_return_if_fail(IS_WINDOW_MENU_DBUSMENU(wm));
+	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(wm);
+
+	if (priv->client != NULL) {
+		return;
+	}
+
+	g_debug("Realizing windows menu: %X, %s, %s", priv->windowid, priv->dbus_addr, priv->dbus_object);
 
 	/* Build the service proxy */
 	priv->props_cancel = g_cancellable_new();
-	g_object_ref(newmenu); /* Take a ref for the async callback */
+	g_object_ref(wm); /* Take a ref for the async callback */
 	g_dbus_proxy_new_for_bus(G_BUS_TYPE_SESSION,
 	                         G_DBUS_PROXY_FLAGS_NONE,
 	                         NULL,
-	                         dbus_addr,
-	                         dbus_object,
+	                         priv->dbus_addr,
+	                         priv->dbus_object,
 	                         "org.freedesktop.DBus.Properties",
 	                         priv->props_cancel,
 	                         props_cb,
-	                         newmenu);
+	                         wm);
 
-	priv->client = dbusmenu_gtkclient_new((gchar *)dbus_addr, (gchar *)dbus_object);
-	GtkAccelGroup * agroup = gtk_accel_group_new();
-	dbusmenu_gtkclient_set_accel_group(priv->client, agroup);
-	g_object_unref(agroup);
+	if (priv->share) {
+		priv->client = shared_client_get(priv->dbus_addr, priv->dbus_object);
+	} else {
+		priv->client = client_new(priv->dbus_addr, priv->dbus_object);
+	}
 
-	g_signal_connect(G_OBJECT(priv->client), DBUSMENU_GTKCLIENT_SIGNAL_ROOT_CHANGED, G_CALLBACK(root_changed),   newmenu);
-	g_signal_connect(G_OBJECT(priv->client), DBUSMENU_CLIENT_SIGNAL_EVENT_RESULT, G_CALLBACK(event_status), newmenu);
-	g_signal_connect(G_OBJECT(priv->client), DBUSMENU_CLIENT_SIGNAL_ITEM_ACTIVATE, G_CALLBACK(item_activate), newmenu);
-	g_signal_connect(G_OBJECT(priv->client), "notify::" DBUSMENU_CLIENT_PROP_STATUS, G_CALLBACK(status_changed), newmenu);
+	g_signal_connect(G_OBJECT(priv->client), DBUSMENU_GTKCLIENT_SIGNAL_ROOT_CHANGED, G_CALLBACK(root_changed),   wm);
+	g_signal_connect(G_OBJECT(priv->client), DBUSMENU_CLIENT_SIGNAL_EVENT_RESULT, G_CALLBACK(event_status), wm);
+	g_signal_connect(G_OBJECT(priv->client), DBUSMENU_CLIENT_SIGNAL_ITEM_ACTIVATE, G_CALLBACK(item_activate), wm);
+	g_signal_connect(G_OBJECT(priv->client), "notify::" DBUSMENU_CLIENT_PROP_STATUS, G_CALLBACK(status_changed), wm);
 
 	DbusmenuMenuitem * root = dbusmenu_client_get_root(DBUSMENU_CLIENT(priv->client));
 	if (root != NULL) {
-		root_changed(DBUSMENU_CLIENT(priv->client), root, newmenu);
+		root_changed(DBUSMENU_CLIENT(priv->client), root, wm);
 	}
 
-	return newmenu;
+	return;
+}
+
+/* Drop the client and the menus it mirrors, we'll get them
+   again from the application on the next realize */
+static void
+unrealize (WindowMenu * wm)
+{
+	g_return_if_fail(IS_WINDOW_MENU_DBUSMENU(wm));
+	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(wm);
+
+	if (priv->client == NULL) {
+		return;
+	}
+
+	g_debug("Unrealizing windows menu: %X", priv->windowid);
+
+	/* Takes the entries with it */
+	root_changed(DBUSMENU_CLIENT(priv->client), NULL, wm);
+
+	g_signal_handlers_disconnect_by_data(priv->client, wm);
+	g_clear_object(&priv->client);
+	g_clear_object(&priv->props);
+
+	if (priv->props_cancel != NULL) {
+		g_cancellable_cancel(priv->props_cancel);
+		g_clear_object(&priv->props_cancel);
+	}
+
+	if (priv->retry_timer != 0) {
+		g_source_remove(priv->retry_timer);
+		priv->retry_timer = 0;
+	}
+
+	priv->error_state = FALSE;
+
+	return;
+}
+
+/* Whether we've got a client yet */
+static gboolean
+is_realized (WindowMenu * wm)
+{
+	g_return_val_if_fail(IS_WINDOW_MENU_DBUSMENU(wm), FALSE);
+	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(wm);
+	return priv->client != NULL;
+}
+
+/* Add up @mi and everything below it, the properties as they came
+   off the bus and a fixed cost for the widgets built for them */
+static gsize
+menuitem_size (DbusmenuMenuitem * mi)
+{
+	gsize size = WINDOW_MENU_ITEM_SIZE;
+
+	GList * props = dbusmenu_menuitem_properties_list(mi);
+	GList * prop;
+	for (prop = props; prop != NULL; prop = g_list_next(prop)) {
+		GVariant * value = dbusmenu_menuitem_property_get_variant(mi, prop->data);
+
+		if (value != NULL) {
+			size += g_variant_get_size(value);
+		}
+	}
+	g_list_free(props);
+
+	GList * child;
+	for (child = dbusmenu_menuitem_get_children(mi); child != NULL; child = g_list_next(child)) {
+		size += menuitem_size(DBUSMENU_MENUITEM(child->data));
+	}
+
+	return size;
+}
+
+/* Estimate what the mirrored menus cost us.  Windows sharing a client
+   each count the whole tree, so this errs on the high side. */
+static gsize
+get_size (WindowMenu * wm)
+{
+	g_return_val_if_fail(IS_WINDOW_MENU_DBUSMENU(wm), 0);
+	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(wm);
+
+	if (priv->root == NULL) {
+		return 0;
+	}
+
+	return menuitem_size(priv->root);
 }
 
 /* Callback from trying to create the proxy for the service, this
@@ -418,8 +642,11 @@ props_cb (GObject * object, GAsyncResult * res, gpointer user_data)
 	GDBusProxy * proxy = g_dbus_proxy_new_for_bus_finish(res, &error);
 
 	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* We're holding a ref, so unrealize could have cancelled
+		   us but the object is still around to drop it */
 		g_error_free (error);
-		return; // Must exit before accessing freed memory
+		g_object_unref(user_data);
+		return;
 	}
 
 	WindowMenuDbusmenu * self = WINDOW_MENU_DBUSMENU(user_data);
@@ -509,8 +736,10 @@ remove_menuitem_signals (DbusmenuMenuitem * mi, gpointer user_data)
 {
 	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menu_entry_realized), user_data);
 	g_signal_handlers_disconnect_by_func(G_OBJECT(mi), G_CALLBACK(menu_entry_realized_child_added), user_data);
-	g_signal_handlers_disconnect_matched(mi, G_SIGNAL_MATCH_FUNC, 0, 0, 0, menu_child_realized, NULL);
-	g_signal_handlers_disconnect_matched(mi, G_SIGNAL_MATCH_FUNC, 0, 0, 0, menu_prop_changed, NULL);
+
+	/* The items can be shared with other windows, so we can't go
+	   and disconnect everything.  Property handlers go with our
+	   entries and child waits notice that the root changed. */
 
 	return;
 }
@@ -521,6 +750,7 @@ root_changed (DbusmenuClient * client, DbusmenuMenuitem * new_root, gpointer use
 {
 	g_return_if_fail(IS_WINDOW_MENU_DBUSMENU(user_data));
 	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(user_data);
+	gint64 start = g_get_monotonic_time();
 
 	/* Remove the old entries */
 	free_entries(G_OBJECT(user_data), TRUE);
@@ -532,6 +762,7 @@ root_changed (DbusmenuClient * client, DbusmenuMenuitem * new_root, gpointer use
 	}
 
 	priv->root = new_root;
+	priv->root_serial++;
 
 	/* See if we've got new entries */
 	if (new_root == NULL) {
@@ -552,6 +783,13 @@ root_changed (DbusmenuClient * client, DbusmenuMenuitem * new_root, gpointer use
 		children = g_list_next(children);
 	}
 
+	gint64 duration = g_get_monotonic_time() - start;
+	appmenu_metrics_count(APPMENU_COUNTER_ROOT_REBUILDS);
+	appmenu_metrics_record(APPMENU_HISTOGRAM_ROOT_REBUILD, duration);
+	APPMENU_TRACE2(root_changed, priv->windowid, duration);
+	appmenu_recorder_span(APPMENU_EVENT_ROOT_CHANGED, priv->windowid,
+	                      g_list_length(dbusmenu_menuitem_get_children(new_root)), start);
+
 	return;
 }
 
@@ -571,14 +809,61 @@ menu_entry_added (DbusmenuMenuitem * root, DbusmenuMenuitem * newentry, guint po
 	return;
 }
 
+/* Build a wait for @newentry, for the current root of @wm */
+static ChildWait *
+child_wait_new (WindowMenuDbusmenu * wm, DbusmenuMenuitem * newentry)
+{
+	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(wm);
+	ChildWait * wait = g_new0(ChildWait, 1);
+
+	g_weak_ref_init(&wait->wm, wm);
+	wait->newentry = g_object_ref(newentry);
+	wait->root_serial = priv->root_serial;
+
+	return wait;
+}
+
+static void
+child_wait_free (ChildWait * wait)
+{
+	g_weak_ref_clear(&wait->wm);
+	g_object_unref(wait->newentry);
+	g_free(wait);
+	return;
+}
+
+/* The application is done getting the menu ready */
+static void
+about_to_show_cb (DbusmenuMenuitem * mi, gpointer user_data)
+{
+	gint64 * start = (gint64 *)user_data;
+
+	appmenu_metrics_record(APPMENU_HISTOGRAM_ABOUT_TO_SHOW, g_get_monotonic_time() - *start);
+	g_free(start);
+
+	return;
+}
+
+/* Tell the application a menu is about to be shown, timing how
+   long it takes to get back to us */
+static void
+send_about_to_show (DbusmenuMenuitem * mi)
+{
+	gint64 * start = g_new(gint64, 1);
+	*start = g_get_monotonic_time();
+
+	appmenu_metrics_count(APPMENU_COUNTER_ABOUT_TO_SHOW);
+	dbusmenu_menuitem_send_about_to_show(mi, about_to_show_cb, start);
+
+	return;
+}
+
 /* A small clean up function to ensure that the data
    gets free'd and the ref lost in all cases. */
 static void
 child_realized_data_cleanup (gpointer user_data, GClosure * closure)
 {
-	gpointer * data = (gpointer *)user_data;
-	g_object_unref(data[1]);
-	g_free(user_data);
+	child_wait_free((ChildWait *)user_data);
 	return;
 }
 
@@ -603,6 +888,7 @@ menu_entry_realized (DbusmenuMenuitem * newentry, gpointer user_data)
 {
 	g_return_if_fail(IS_WINDOW_MENU_DBUSMENU(user_data));
 	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(user_data);
+	gint64 start = APPMENU_TRACE_NOW();
 
 	GtkMenu * menu = dbusmenu_gtkclient_menuitem_get_submenu(priv->client, newentry);
 
@@ -610,36 +896,32 @@ menu_entry_realized (DbusmenuMenuitem * newentry, gpointer user_data)
 	   we can scare some up for fun. */
 	GList * children = dbusmenu_menuitem_get_children(newentry);
 	if (children == NULL && g_strcmp0(DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU, dbusmenu_menuitem_property_get(newentry, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY)) == 0) {
-		dbusmenu_menuitem_send_about_to_show(newentry, NULL, NULL);
+		send_about_to_show(newentry);
 	}
 
 	if (menu == NULL) {
 		if (children != NULL) {
-			gpointer * data = g_new(gpointer, 2);
-			data[0] = user_data;
-			data[1] = (DbusmenuMenuitem*)g_object_ref(newentry);
+			ChildWait * wait = child_wait_new(WINDOW_MENU_DBUSMENU(user_data), newentry);
 
-			g_signal_connect_data(G_OBJECT(children->data), DBUSMENU_MENUITEM_SIGNAL_REALIZED, G_CALLBACK(menu_child_realized), data, child_realized_data_cleanup, 0);
+			g_signal_connect_data(G_OBJECT(children->data), DBUSMENU_MENUITEM_SIGNAL_REALIZED, G_CALLBACK(menu_child_realized), wait, child_realized_data_cleanup, 0);
 		} else {
 			/* Menu entry has no children */
-			gpointer * data = g_new(gpointer, 2);
-			data[0] = user_data;
-			data[1] = (DbusmenuMenuitem*)g_object_ref(newentry);
+			ChildWait * wait = child_wait_new(WINDOW_MENU_DBUSMENU(user_data), newentry);
 
 			/* Make sure the menu item gets displayed on the menu bar */
-			menu_child_realized(NULL, data);
-			g_free (data);
+			menu_child_realized(NULL, wait);
+			child_wait_free(wait);
 
 			g_signal_connect(G_OBJECT(newentry), DBUSMENU_MENUITEM_SIGNAL_CHILD_ADDED, G_CALLBACK(menu_entry_realized_child_added), user_data);
 		}
 	} else {
-		gpointer * data = g_new(gpointer, 2);
-		data[0] = user_data;
-		data[1] = newentry;
+		ChildWait * wait = child_wait_new(WINDOW_MENU_DBUSMENU(user_data), newentry);
 
-		menu_child_realized(NULL, data);
-		g_free (data);
+		menu_child_realized(NULL, wait);
+		child_wait_free(wait);
 	}
+
+	APPMENU_TRACE2(menu_entry_realized, priv->windowid, APPMENU_TRACE_NOW() - start);
 	
 	return;
 }
@@ -684,24 +966,33 @@ static void
 menu_child_realized (DbusmenuMenuitem * child, gpointer user_data)
 {
 	/* Grab our values out to stack variables */
-	DbusmenuMenuitem * newentry = DBUSMENU_MENUITEM(((gpointer *)user_data)[1]);
-	WindowMenuDbusmenu * wm = WINDOW_MENU_DBUSMENU(((gpointer *)user_data)[0]);
-
-	g_return_if_fail(newentry != NULL);
-	g_return_if_fail(wm != NULL);
-
-	/* Disconnection below will drop the ref for this signal
-	   handler, let's make sure that's not a problem */
-	g_object_ref(G_OBJECT(newentry));
+	ChildWait * wait = (ChildWait *)user_data;
+	DbusmenuMenuitem * newentry = DBUSMENU_MENUITEM(g_object_ref(wait->newentry));
+	WindowMenuDbusmenu * wm = g_weak_ref_get(&wait->wm);
+	guint root_serial = wait->root_serial;
+	gint64 start = APPMENU_TRACE_NOW();
 
 	/* Only care about the first */
 	/* This will cause the cleanup function attached to the signal
-	   handler to be run. */
+	   handler to be run, so no touching the wait after this. */
 	if (child != NULL) {
 		g_signal_handlers_disconnect_by_func(G_OBJECT(child), menu_child_realized, user_data);
 	}
 
+	if (wm == NULL) {
+		g_object_unref(newentry);
+		return;
+	}
+
 	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(wm);
+
+	/* The menus got rebuilt or dropped since we started waiting,
+	   whoever did that is taking care of the entries now */
+	if (root_serial != priv->root_serial || get_entry(wm, newentry, NULL) != NULL) {
+		g_object_unref(newentry);
+		g_object_unref(wm);
+		return;
+	}
 	WMEntry * wmentry = g_new0(WMEntry, 1);
 	wmentry->wm = wm;
 	IndicatorObjectEntry * entry = &wmentry->ioentry;
@@ -726,7 +1017,13 @@ menu_child_realized (DbusmenuMenuitem * child, gpointer user_data)
 		g_debug("Submenu for %s is NULL", dbusmenu_menuitem_property_get(newentry, DBUSMENU_MENUITEM_PROP_LABEL));
 	} else {
 		g_object_ref(entry->menu);
-		gtk_menu_detach(entry->menu);
+		/* Take it off the client's own menuitem.  Another window on
+		   the same client could have done that already and the menu
+		   could be on the panel for it now, which has to stay. */
+		GtkWidget * attach = gtk_menu_get_attach_widget(entry->menu);
+		if (attach != NULL && attach == GTK_WIDGET(dbusmenu_gtkclient_menuitem_get(priv->client, newentry))) {
+			gtk_menu_detach(entry->menu);
+		}
 		g_signal_connect(entry->menu, "destroy", G_CALLBACK(gtk_widget_destroyed), &entry->menu);
 	}
 
@@ -749,8 +1046,11 @@ menu_child_realized (DbusmenuMenuitem * child, gpointer user_data)
 
 	g_array_append_val(priv->entries, wmentry);
 
+	appmenu_recorder_mark(APPMENU_EVENT_ENTRY_ADDED, priv->windowid, 0);
 	g_signal_emit_by_name(G_OBJECT(wm), WINDOW_MENU_SIGNAL_ENTRY_ADDED, entry, TRUE);
 
+	APPMENU_TRACE2(menu_child_realized, priv->windowid, APPMENU_TRACE_NOW() - start);
+
 	g_object_unref(newentry);
 
 	guint pos = dbusmenu_menuitem_get_position (newentry,
@@ -766,6 +1066,8 @@ menu_child_realized (DbusmenuMenuitem * child, gpointer user_data)
 		g_object_unref(priv->root);
 	}
 
+	g_object_unref(wm);
+
 	return;
 }
 
@@ -786,6 +1088,7 @@ menu_entry_removed (DbusmenuMenuitem * root, DbusmenuMenuitem * oldentry, gpoint
 
 	if (entry != NULL) {
 		g_array_remove_index(priv->entries, position);
+		appmenu_recorder_mark(APPMENU_EVENT_ENTRY_REMOVED, priv->windowid, 0);
 		g_signal_emit_by_name(G_OBJECT(user_data), WINDOW_MENU_SIGNAL_ENTRY_REMOVED, entry, TRUE);
 		entry_free(entry);
 	} else {
@@ -814,12 +1117,7 @@ window_menu_dbusmenu_get_path (WindowMenuDbusmenu * wm)
 {
 	g_return_val_if_fail(IS_WINDOW_MENU_DBUSMENU(wm), NULL);
 	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(wm);
-	GValue obj = {0};
-	g_value_init(&obj, G_TYPE_STRING);
-	g_object_get_property(G_OBJECT(priv->client), DBUSMENU_CLIENT_PROP_DBUS_OBJECT, &obj);
-	gchar * retval = g_value_dup_string(&obj);
-	g_value_unset(&obj);
-	return retval;
+	return g_strdup(priv->dbus_object);
 }
 
 /* Get the address of this object */
@@ -828,12 +1126,7 @@ window_menu_dbusmenu_get_address (WindowMenuDbusmenu * wm)
 {
 	g_return_val_if_fail(IS_WINDOW_MENU_DBUSMENU(wm), NULL);
 	WindowMenuDbusmenuPrivate * priv = WINDOW_MENU_DBUSMENU_GET_PRIVATE(wm);
-	GValue obj = {0};
-	g_value_init(&obj, G_TYPE_STRING);
-	g_object_get_property(G_OBJECT(priv->client), DBUSMENU_CLIENT_PROP_DBUS_NAME, &obj);
-	gchar * retval = g_value_dup_string(&obj);
-	g_value_unset(&obj);
-	return retval;
+	return g_strdup(priv->dbus_addr);
 }
 
 /* Return whether we're in an error state or not */
@@ -892,7 +1185,7 @@ entry_activate (WindowMenu * wm, IndicatorObjectEntry * entry, guint timestamp)
 		                               0);
 	/* Otherwise, show the menu */
 	} else {
-		dbusmenu_menuitem_send_about_to_show(wme->mi, NULL, NULL);
+		send_about_to_show(wme->mi);
 	}
 	return;
 }
@@ -21,17 +21,47 @@
 #include "config.h"
 #endif
 
-#include <libbamf/libbamf.h>
 #include <gio/gio.h>
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
 #include <gio/gdesktopappinfo.h>
 
 #include "window-menu-model.h"
+#include "appmenu-metrics.h"
+#include "appmenu-trace.h"
+#include "appmenu-recorder.h"
+
+/* The widgets built from a menu model.  Windows of an application
+   usually export the same menus and only their window actions
+   differ, so they share the widgets and the window on the panel
+   gets its actions put in. */
+typedef struct _ModelMirror ModelMirror;
+struct _ModelMirror {
+	gint ref_count;
+	gchar * key;
+	GtkWidget * widget;
+	WindowMenuModel * owner;
+};
+
+typedef enum {
+	MIRROR_MENU,
+	MIRROR_MENUBAR
+} MirrorKind;
 
 struct _WindowMenuModelPrivate {
 	guint xid;
 
+	/* Where the menus live, kept so they can be rebuilt */
+	gchar * unique_bus_name;
+	gchar * app_menu_object_path;
+	gchar * menubar_object_path;
+	gchar * application_object_path;
+	gchar * window_object_path;
+	gchar * unity_object_path;
+	gchar * app_name;
+	gboolean realized;
+	gboolean share;
+
 	GtkAccelGroup * accel_group;
 	GActionGroup * app_actions;
 	GActionGroup * win_actions;
@@ -39,11 +69,13 @@ struct _WindowMenuModelPrivate {
 
 	/* Application Menu */
 	GDBusMenuModel * app_menu_model;
+	ModelMirror * app_mirror;
 	IndicatorObjectEntry application_menu;
 	gboolean has_application_menu;
 
 	/* Window Menus */
 	GDBusMenuModel * win_menu_model;
+	ModelMirror * win_mirror;
 	GtkMenuBar * win_menu;
 };
 
@@ -54,6 +86,7 @@ struct _WindowMenuModelPrivate {
 static void                window_menu_model_class_init (WindowMenuModelClass *klass);
 static void                window_menu_model_init       (WindowMenuModel *self);
 static void                window_menu_model_dispose    (GObject *object);
+static void                window_menu_model_finalize   (GObject *object);
 
 /* Window Menu subclassin' */
 static GList *             get_entries                  (WindowMenu * wm);
@@ -62,6 +95,11 @@ static guint               get_location                 (WindowMenu * wm,
 static WindowMenuStatus    get_status                   (WindowMenu * wm);
 static gboolean            get_error_state              (WindowMenu * wm);
 static guint               get_xid                      (WindowMenu * wm);
+static void                realize                      (WindowMenu * wm);
+static void                unrealize                    (WindowMenu * wm);
+static gboolean            is_realized                  (WindowMenu * wm);
+static gsize               get_size                     (WindowMenu * wm);
+static void                focus                        (WindowMenu * wm);
 
 /* GLib boilerplate */
 G_DEFINE_TYPE (WindowMenuModel, window_menu_model, WINDOW_MENU_TYPE);
@@ -74,6 +112,10 @@ G_DEFINE_TYPE (WindowMenuModel, window_menu_model, WINDOW_MENU_TYPE);
 /* Entry data on the menuitem */
 #define ENTRY_DATA  "window-menu-model-menuitem-entry"
 
+/* Shared mirrors by the kind, bus name and path of their model.
+   These aren't refs, mirrors leave when the last window drops them. */
+static GHashTable * mirrors = NULL;
+
 static void
 window_menu_model_class_init (WindowMenuModelClass *klass)
 {
@@ -82,6 +124,7 @@ window_menu_model_class_init (WindowMenuModelClass *klass)
 	g_type_class_add_private (klass, sizeof (WindowMenuModelPrivate));
 
 	object_class->dispose = window_menu_model_dispose;
+	object_class->finalize = window_menu_model_finalize;
 
 	WindowMenuClass * wm_class = WINDOW_MENU_CLASS(klass);
 
@@ -90,6 +133,11 @@ window_menu_model_class_init (WindowMenuModelClass *klass)
 	wm_class->get_status = get_status;
 	wm_class->get_error_state = get_error_state;
 	wm_class->get_xid = get_xid;
+	wm_class->realize = realize;
+	wm_class->unrealize = unrealize;
+	wm_class->is_realized = is_realized;
+	wm_class->get_size = get_size;
+	wm_class->focus = focus;
 
 	return;
 }
@@ -101,44 +149,195 @@ window_menu_model_init (WindowMenuModel *self)
 
 	self->priv->accel_group = gtk_accel_group_new();
 
+	appmenu_metrics_add(APPMENU_COUNTER_WINDOWS_MODEL, 1);
+
 	return;
 }
 
+/* Put the actions of @menu in the widgets, or take them
+   all out when there is no @menu */
 static void
-window_menu_model_dispose (GObject *object)
+mirror_set_owner (ModelMirror * mirror, WindowMenuModel * menu)
 {
-	WindowMenuModel * menu = WINDOW_MENU_MODEL(object);
+	if (mirror->owner == menu) {
+		return;
+	}
+
+	mirror->owner = menu;
+
+	gtk_widget_insert_action_group(mirror->widget, ACTION_MUX_PREFIX_APP, menu != NULL ? menu->priv->app_actions : NULL);
+	gtk_widget_insert_action_group(mirror->widget, ACTION_MUX_PREFIX_WIN, menu != NULL ? menu->priv->win_actions : NULL);
+	gtk_widget_insert_action_group(mirror->widget, ACTION_MUX_PREFIX_UNITY, menu != NULL ? menu->priv->unity_actions : NULL);
+
+	return;
+}
+
+/* Get the widgets for @model at @path, built for @menu unless it
+   shares them and another window has them already */
+static ModelMirror *
+mirror_get (WindowMenuModel * menu, MirrorKind kind, const gchar * path, GMenuModel * model)
+{
+	ModelMirror * mirror = NULL;
+	gchar * key = NULL;
+
+	if (menu->priv->share) {
+		/* Unique names start with a colon and can't have a slash,
+		   paths start with one, so the parts can't run together */
+		key = g_strconcat(kind == MIRROR_MENUBAR ? "menubar" : "menu", menu->priv->unique_bus_name, path, NULL);
+
+		if (mirrors != NULL) {
+			mirror = g_hash_table_lookup(mirrors, key);
+		}
+
+		if (mirror != NULL) {
+			g_debug("Sharing menus at %s %s with %X", menu->priv->unique_bus_name, path, menu->priv->xid);
+			mirror->ref_count++;
+			g_free(key);
+			return mirror;
+		}
+	}
+
+	mirror = g_new0(ModelMirror, 1);
+	mirror->ref_count = 1;
+	mirror->key = key;
+
+	if (kind == MIRROR_MENUBAR) {
+		mirror->widget = gtk_menu_bar_new_from_model(model);
+	} else {
+		mirror->widget = gtk_menu_new_from_model(model);
+	}
+	g_object_ref_sink(mirror->widget);
+
+	mirror_set_owner(mirror, menu);
+
+	if (key != NULL) {
+		if (mirrors == NULL) {
+			mirrors = g_hash_table_new(g_str_hash, g_str_equal);
+		}
+
+		g_hash_table_insert(mirrors, key, mirror);
+	}
+
+	return mirror;
+}
 
+/* @menu is done with the widgets, they go with the last window */
+static void
+mirror_unref (ModelMirror * mirror, WindowMenuModel * menu)
+{
+	/* Its actions are going away with it */
+	if (mirror->owner == menu) {
+		mirror_set_owner(mirror, NULL);
+	}
+
+	mirror->ref_count--;
+	if (mirror->ref_count > 0) {
+		return;
+	}
+
+	if (mirror->key != NULL && mirrors != NULL) {
+		g_hash_table_remove(mirrors, mirror->key);
+	}
+
+	gtk_widget_destroy(mirror->widget);
+	g_object_unref(mirror->widget);
+
+	g_free(mirror->key);
+	g_free(mirror);
+
+	return;
+}
+
+/* Drop the widgets, models and action groups, everything
+   that gets built on realize */
+static void
+drop_menus (WindowMenuModel * menu, gboolean should_signal)
+{
 	if (menu->priv->has_application_menu) {
+		appmenu_recorder_mark(APPMENU_EVENT_ENTRY_REMOVED, menu->priv->xid, 0);
 		g_signal_emit_by_name(menu, WINDOW_MENU_SIGNAL_ENTRY_REMOVED, &menu->priv->application_menu);
 		menu->priv->has_application_menu = FALSE;
 	}
 
-	g_clear_object(&menu->priv->accel_group);
+	if (should_signal && menu->priv->win_menu != NULL) {
+		GList * children = gtk_container_get_children(GTK_CONTAINER(menu->priv->win_menu));
+		GList * child;
+		for (child = children; child != NULL; child = g_list_next(child)) {
+			gpointer entry = g_object_get_data(child->data, ENTRY_DATA);
+
+			if (entry != NULL) {
+				appmenu_recorder_mark(APPMENU_EVENT_ENTRY_REMOVED, menu->priv->xid, 0);
+				g_signal_emit_by_name(menu, WINDOW_MENU_SIGNAL_ENTRY_REMOVED, entry);
+			}
+		}
+		g_list_free(children);
+	}
 
 	/* Application Menu */
 	g_clear_object(&menu->priv->app_menu_model);
 	g_clear_object(&menu->priv->application_menu.label);
 	g_clear_object(&menu->priv->application_menu.menu);
 
+	if (menu->priv->app_mirror) {
+		mirror_unref(menu->priv->app_mirror, menu);
+		menu->priv->app_mirror = NULL;
+	}
+
 	/* Window Menus */
 	g_clear_object(&menu->priv->win_menu_model);
 
 	if (menu->priv->win_menu) {
 		g_signal_handlers_disconnect_by_data(menu->priv->win_menu, menu);
-		gtk_widget_destroy (GTK_WIDGET (menu->priv->win_menu));
 		g_object_unref (menu->priv->win_menu);
 		menu->priv->win_menu = NULL;
 	}
 
+	if (menu->priv->win_mirror) {
+		mirror_unref(menu->priv->win_mirror, menu);
+		menu->priv->win_mirror = NULL;
+	}
+
 	g_clear_object(&menu->priv->unity_actions);
 	g_clear_object(&menu->priv->win_actions);
 	g_clear_object(&menu->priv->app_actions);
 
+	menu->priv->realized = FALSE;
+
+	return;
+}
+
+static void
+window_menu_model_dispose (GObject *object)
+{
+	WindowMenuModel * menu = WINDOW_MENU_MODEL(object);
+
+	drop_menus(menu, FALSE);
+
+	g_clear_object(&menu->priv->accel_group);
+
 	G_OBJECT_CLASS (window_menu_model_parent_class)->dispose (object);
 	return;
 }
 
+static void
+window_menu_model_finalize (GObject *object)
+{
+	WindowMenuModel * menu = WINDOW_MENU_MODEL(object);
+
+	g_free(menu->priv->unique_bus_name);
+	g_free(menu->priv->app_menu_object_path);
+	g_free(menu->priv->menubar_object_path);
+	g_free(menu->priv->application_object_path);
+	g_free(menu->priv->window_object_path);
+	g_free(menu->priv->unity_object_path);
+	g_free(menu->priv->app_name);
+
+	appmenu_metrics_add(APPMENU_COUNTER_WINDOWS_MODEL, -1);
+
+	G_OBJECT_CLASS (window_menu_model_parent_class)->finalize (object);
+	return;
+}
+
 /* Adds the application menu and turns the whole thing into an object
    entry that can be used elsewhere */
 static void
@@ -157,21 +356,12 @@ add_application_menu (WindowMenuModel * menu, const gchar * appname, GMenuModel
 	g_object_ref_sink(menu->priv->application_menu.label);
 	gtk_widget_show(GTK_WIDGET(menu->priv->application_menu.label));
 
-	menu->priv->application_menu.menu = GTK_MENU(gtk_menu_new_from_model(model));
-	if (menu->priv->app_actions) {
-		gtk_widget_insert_action_group(GTK_WIDGET(menu->priv->application_menu.menu), ACTION_MUX_PREFIX_APP, menu->priv->app_actions);
-	}
-	if (menu->priv->win_actions) {
-		gtk_widget_insert_action_group(GTK_WIDGET(menu->priv->application_menu.menu), ACTION_MUX_PREFIX_WIN, menu->priv->win_actions);
-	}
-	if (menu->priv->unity_actions) {
-		gtk_widget_insert_action_group(GTK_WIDGET(menu->priv->application_menu.menu), ACTION_MUX_PREFIX_UNITY, menu->priv->unity_actions);
-	}
-
+	menu->priv->app_mirror = mirror_get(menu, MIRROR_MENU, menu->priv->app_menu_object_path, model);
+	menu->priv->application_menu.menu = GTK_MENU(g_object_ref(menu->priv->app_mirror->widget));
 	gtk_widget_show(GTK_WIDGET(menu->priv->application_menu.menu));
-	g_object_ref_sink(menu->priv->application_menu.menu);
 
 	menu->priv->has_application_menu = TRUE;
+	appmenu_recorder_mark(APPMENU_EVENT_ENTRY_ADDED, menu->priv->xid, 0);
 	g_signal_emit_by_name(menu, WINDOW_MENU_SIGNAL_ENTRY_ADDED, &menu->priv->application_menu);
 }
 
@@ -380,6 +570,7 @@ item_inserted_cb (GtkContainer *menu,
 	}
 
 	if (g_object_get_data(G_OBJECT(widget), ENTRY_DATA) != NULL) {
+		appmenu_recorder_mark(APPMENU_EVENT_ENTRY_ADDED, WINDOW_MENU_MODEL(data)->priv->xid, 0);
 		g_signal_emit_by_name(data, WINDOW_MENU_SIGNAL_ENTRY_ADDED, g_object_get_data(G_OBJECT(widget), ENTRY_DATA));
 	}
 
@@ -390,6 +581,7 @@ item_inserted_cb (GtkContainer *menu,
 static void
 item_removed_cb (GtkContainer *menu, GtkWidget *widget, gpointer data)
 {
+	appmenu_recorder_mark(APPMENU_EVENT_ENTRY_REMOVED, WINDOW_MENU_MODEL(data)->priv->xid, 0);
 	g_signal_emit_by_name(data, WINDOW_MENU_SIGNAL_ENTRY_REMOVED, g_object_get_data(G_OBJECT(widget), ENTRY_DATA));
 }
 
@@ -400,16 +592,8 @@ add_window_menu (WindowMenuModel * menu, GMenuModel * model)
 {
 	menu->priv->win_menu_model = (GDBusMenuModel*)g_object_ref(model);
 
-	menu->priv->win_menu = GTK_MENU_BAR(gtk_menu_bar_new_from_model(model));
-	g_assert(menu->priv->win_menu != NULL);
-	g_object_ref_sink(menu->priv->win_menu);
-
-	if (menu->priv->app_actions)
-		gtk_widget_insert_action_group(GTK_WIDGET(menu->priv->win_menu), ACTION_MUX_PREFIX_APP, menu->priv->app_actions);
-	if (menu->priv->win_actions)
-		gtk_widget_insert_action_group(GTK_WIDGET(menu->priv->win_menu), ACTION_MUX_PREFIX_WIN, menu->priv->win_actions);
-	if (menu->priv->unity_actions)
-		gtk_widget_insert_action_group(GTK_WIDGET(menu->priv->win_menu), ACTION_MUX_PREFIX_UNITY, menu->priv->unity_actions);
+	menu->priv->win_mirror = mirror_get(menu, MIRROR_MENUBAR, menu->priv->menubar_object_path, model);
+	menu->priv->win_menu = GTK_MENU_BAR(g_object_ref(menu->priv->win_mirror->widget));
 
 	g_signal_connect(G_OBJECT(menu->priv->win_menu), "insert", G_CALLBACK (item_inserted_cb), menu);
 	g_signal_connect(G_OBJECT(menu->priv->win_menu), "remove", G_CALLBACK (item_removed_cb), menu);
@@ -423,85 +607,128 @@ add_window_menu (WindowMenuModel * menu, GMenuModel * model)
 			continue;
 		}
 
-		entry_on_menuitem(menu, gmi);
+		/* Shared items already have theirs, other windows use them */
+		if (g_object_get_data(G_OBJECT(gmi), ENTRY_DATA) == NULL) {
+			entry_on_menuitem(menu, gmi);
+		}
+
+		if (g_object_get_data(G_OBJECT(gmi), ENTRY_DATA) != NULL) {
+			appmenu_recorder_mark(APPMENU_EVENT_ENTRY_ADDED, menu->priv->xid, 0);
+			g_signal_emit_by_name(menu, WINDOW_MENU_SIGNAL_ENTRY_ADDED, g_object_get_data(G_OBJECT(gmi), ENTRY_DATA));
+		}
 	}
 	g_list_free(children);
 
 	return;
 }
 
-/* Builds the menu model from the window for the application */
+/* Builds the menu model from the window @xid, the properties are
+   read through @tracker unless @props has them already.  With @share
+   the widgets are shared with other windows on the same menus, so
+   only do that when no two of them are shown at once. */
 WindowMenuModel *
-window_menu_model_new (BamfApplication * app, BamfWindow * window)
+window_menu_model_new (WindowTracker * tracker, guint xid, WindowProps * props, gboolean share)
 {
-	g_return_val_if_fail(BAMF_IS_APPLICATION(app), NULL);
-	g_return_val_if_fail(BAMF_IS_WINDOW(window), NULL);
+	g_return_val_if_fail(IS_WINDOW_TRACKER(tracker), NULL);
+	g_return_val_if_fail(xid != 0, NULL);
 
+	gint64 start = APPMENU_TRACE_NOW();
 	WindowMenuModel * menu = g_object_new(WINDOW_MENU_MODEL_TYPE, NULL);
 
-	menu->priv->xid = bamf_window_get_xid(window);
+	menu->priv->xid = xid;
+	menu->priv->share = share;
 
-	gchar *unique_bus_name;
-	gchar *app_menu_object_path;
-	gchar *menubar_object_path;
-	gchar *application_object_path;
-	gchar *window_object_path;
-	gchar *unity_object_path;
-	GDBusConnection *session;
-
-	unique_bus_name = bamf_window_get_utf8_prop (window, "_GTK_UNIQUE_BUS_NAME");
+	if (props != NULL) {
+		menu->priv->unique_bus_name = g_strdup (props->unique_bus_name);
+	} else {
+		menu->priv->unique_bus_name = window_tracker_get_window_prop (tracker, xid, "_GTK_UNIQUE_BUS_NAME");
+	}
 
-	if (unique_bus_name == NULL) {
+	if (menu->priv->unique_bus_name == NULL) {
 		/* If this isn't set, we won't get very far... */
+		g_object_unref(menu);
 		return NULL;
 	}
 
-	app_menu_object_path = bamf_window_get_utf8_prop (window, "_GTK_APP_MENU_OBJECT_PATH");
-	menubar_object_path = bamf_window_get_utf8_prop (window, "_GTK_MENUBAR_OBJECT_PATH");
-	application_object_path = bamf_window_get_utf8_prop (window, "_GTK_APPLICATION_OBJECT_PATH");
-	window_object_path = bamf_window_get_utf8_prop (window, "_GTK_WINDOW_OBJECT_PATH");
-	unity_object_path = bamf_window_get_utf8_prop (window, "_UNITY_OBJECT_PATH");
-
-	session = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
-
-	/* Setup actions */
-	if (application_object_path != NULL) {
-		menu->priv->app_actions = G_ACTION_GROUP(g_dbus_action_group_get (session, unique_bus_name, application_object_path));
-	}
-
-	if (window_object_path != NULL) {
-		menu->priv->win_actions = G_ACTION_GROUP(g_dbus_action_group_get (session, unique_bus_name, window_object_path));
-	}
-
-	if (unity_object_path != NULL) {
-		menu->priv->unity_actions = G_ACTION_GROUP(g_dbus_action_group_get (session, unique_bus_name, unity_object_path));
+	if (props != NULL) {
+		menu->priv->app_menu_object_path = g_strdup (props->app_menu_object_path);
+		menu->priv->menubar_object_path = g_strdup (props->menubar_object_path);
+		menu->priv->application_object_path = g_strdup (props->application_object_path);
+		menu->priv->window_object_path = g_strdup (props->window_object_path);
+		menu->priv->unity_object_path = g_strdup (props->unity_object_path);
+	} else {
+		menu->priv->app_menu_object_path = window_tracker_get_window_prop (tracker, xid, "_GTK_APP_MENU_OBJECT_PATH");
+		menu->priv->menubar_object_path = window_tracker_get_window_prop (tracker, xid, "_GTK_MENUBAR_OBJECT_PATH");
+		menu->priv->application_object_path = window_tracker_get_window_prop (tracker, xid, "_GTK_APPLICATION_OBJECT_PATH");
+		menu->priv->window_object_path = window_tracker_get_window_prop (tracker, xid, "_GTK_WINDOW_OBJECT_PATH");
+		menu->priv->unity_object_path = window_tracker_get_window_prop (tracker, xid, "_UNITY_OBJECT_PATH");
 	}
 
-	/* Build us some menus */
-	if (app_menu_object_path != NULL) {
-		const gchar * desktop_path = bamf_application_get_desktop_file(app);
-		gchar * app_name = NULL;
+	if (menu->priv->app_menu_object_path != NULL) {
+		gchar * desktop_path = window_tracker_get_desktop_file(tracker, xid);
 
 		if (desktop_path != NULL) {
 			GDesktopAppInfo * desktop = g_desktop_app_info_new_from_filename(desktop_path);
 
 			if (desktop != NULL) {
-				app_name = g_strdup(g_app_info_get_name(G_APP_INFO(desktop)));
+				menu->priv->app_name = g_strdup(g_app_info_get_name(G_APP_INFO(desktop)));
 
 				g_object_unref(desktop);
 			}
 		}
 
-		GMenuModel * model = G_MENU_MODEL(g_dbus_menu_model_get (session, unique_bus_name, app_menu_object_path));
+		g_free(desktop_path);
+	}
+
+	realize(WINDOW_MENU(menu));
+
+	APPMENU_TRACE2(window_menu_model_new, menu->priv->xid, APPMENU_TRACE_NOW() - start);
+
+	return menu;
+}
 
-		add_application_menu(menu, app_name, model);
+/* Build the action groups and the menus from the paths we
+   got off of the window */
+static void
+realize (WindowMenu * wm)
+{
+	g_return_if_fail(IS_WINDOW_MENU_MODEL(wm));
+	WindowMenuModel * menu = WINDOW_MENU_MODEL(wm);
+	WindowMenuModelPrivate * priv = menu->priv;
+
+	if (priv->realized) {
+		return;
+	}
+
+	GDBusConnection * session = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+	g_return_if_fail(session != NULL);
+
+	priv->realized = TRUE;
+
+	/* Setup actions */
+	if (priv->application_object_path != NULL) {
+		priv->app_actions = G_ACTION_GROUP(g_dbus_action_group_get (session, priv->unique_bus_name, priv->application_object_path));
+	}
+
+	if (priv->window_object_path != NULL) {
+		priv->win_actions = G_ACTION_GROUP(g_dbus_action_group_get (session, priv->unique_bus_name, priv->window_object_path));
+	}
+
+	if (priv->unity_object_path != NULL) {
+		priv->unity_actions = G_ACTION_GROUP(g_dbus_action_group_get (session, priv->unique_bus_name, priv->unity_object_path));
+	}
+
+	/* Build us some menus */
+	if (priv->app_menu_object_path != NULL) {
+		GMenuModel * model = G_MENU_MODEL(g_dbus_menu_model_get (session, priv->unique_bus_name, priv->app_menu_object_path));
+
+		add_application_menu(menu, priv->app_name, model);
 
 		g_object_unref(model);
-		g_free(app_name);
 	}
 
-	if (menubar_object_path != NULL) {
-		GMenuModel * model = G_MENU_MODEL(g_dbus_menu_model_get (session, unique_bus_name, menubar_object_path));
+	if (priv->menubar_object_path != NULL) {
+		GMenuModel * model = G_MENU_MODEL(g_dbus_menu_model_get (session, priv->unique_bus_name, priv->menubar_object_path));
 
 		add_window_menu(menu, model);
 
@@ -512,16 +739,101 @@ window_menu_model_new (BamfApplication * app, BamfWindow * window)
 	 * enabled/disabled.  how to deal with that?
 	 */
 
-	g_free (unique_bus_name);
-	g_free (app_menu_object_path);
-	g_free (menubar_object_path);
-	g_free (application_object_path);
-	g_free (window_object_path);
-	g_free (unity_object_path);
-
 	g_object_unref (session);
 
-	return menu;
+	return;
+}
+
+/* Go back to just knowing where the menus are */
+static void
+unrealize (WindowMenu * wm)
+{
+	g_return_if_fail(IS_WINDOW_MENU_MODEL(wm));
+	drop_menus(WINDOW_MENU_MODEL(wm), TRUE);
+	return;
+}
+
+static gboolean
+is_realized (WindowMenu * wm)
+{
+	g_return_val_if_fail(IS_WINDOW_MENU_MODEL(wm), FALSE);
+	return WINDOW_MENU_MODEL(wm)->priv->realized;
+}
+
+/* Add up the items in @shell and their submenus */
+static gsize
+menu_shell_size (GtkMenuShell * shell)
+{
+	gsize size = 0;
+
+	GList * children = gtk_container_get_children(GTK_CONTAINER(shell));
+	GList * child;
+	for (child = children; child != NULL; child = g_list_next(child)) {
+		size += WINDOW_MENU_ITEM_SIZE;
+
+		if (!GTK_IS_MENU_ITEM(child->data)) {
+			continue;
+		}
+
+		GtkWidget * submenu = gtk_menu_item_get_submenu(GTK_MENU_ITEM(child->data));
+		if (submenu != NULL) {
+			size += menu_shell_size(GTK_MENU_SHELL(submenu));
+		}
+	}
+	g_list_free(children);
+
+	return size;
+}
+
+/* Estimate what the widgets built from the models cost us, the
+   models themselves only hold what the widgets show */
+static gsize
+get_size (WindowMenu * wm)
+{
+	g_return_val_if_fail(IS_WINDOW_MENU_MODEL(wm), 0);
+	WindowMenuModelPrivate * priv = WINDOW_MENU_MODEL(wm)->priv;
+	gsize size = 0;
+
+	/* Shared widgets are split between the windows using them */
+	if (priv->app_mirror != NULL) {
+		size += menu_shell_size(GTK_MENU_SHELL(priv->app_mirror->widget)) / priv->app_mirror->ref_count;
+	}
+
+	if (priv->win_mirror != NULL) {
+		size += menu_shell_size(GTK_MENU_SHELL(priv->win_mirror->widget)) / priv->win_mirror->ref_count;
+	}
+
+	return size;
+}
+
+/* Our window is on the panel, the shared widgets get its actions
+   and their entries say they're ours */
+static void
+focus (WindowMenu * wm)
+{
+	g_return_if_fail(IS_WINDOW_MENU_MODEL(wm));
+	WindowMenuModel * menu = WINDOW_MENU_MODEL(wm);
+
+	if (menu->priv->app_mirror != NULL) {
+		mirror_set_owner(menu->priv->app_mirror, menu);
+	}
+
+	if (menu->priv->win_mirror != NULL) {
+		mirror_set_owner(menu->priv->win_mirror, menu);
+
+		GList * children = gtk_container_get_children(GTK_CONTAINER(menu->priv->win_menu));
+		GList * child;
+		for (child = children; child != NULL; child = g_list_next(child)) {
+			IndicatorObjectEntry * entry = g_object_get_data(child->data, ENTRY_DATA);
+
+			if (entry != NULL) {
+				entry->parent_window = menu->priv->xid;
+			}
+		}
+		g_list_free(children);
+	}
+
+	return;
 }
 
 /* Get the list of entries */
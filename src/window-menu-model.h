@@ -22,8 +22,9 @@
 
 #include <glib.h>
 #include <glib-object.h>
-#include <libbamf/bamf-window.h>
 #include "window-menu.h"
+#include "window-props.h"
+#include "window-tracker.h"
 
 G_BEGIN_DECLS
 
@@ -49,7 +50,7 @@ struct _WindowMenuModel {
 };
 
 GType window_menu_model_get_type (void);
-WindowMenuModel * window_menu_model_new (BamfApplication * app, BamfWindow * window);
+WindowMenuModel * window_menu_model_new (WindowTracker * tracker, guint xid, WindowProps * props, gboolean share);
 
 G_END_DECLS
 
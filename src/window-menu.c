@@ -230,3 +230,81 @@ window_menu_entry_activate (WindowMenu * wm, IndicatorObjectEntry * entry, guint
 		return;
 	}
 }
+
+/* Build whatever the backend deferred when it was created, once
+   the menus are about to be shown.  Entries get signaled as they
+   show up, same as for a newly created menu. */
+void
+window_menu_realize (WindowMenu * wm)
+{
+	g_return_if_fail (IS_WINDOW_MENU(wm));
+
+	WindowMenuClass * class = WINDOW_MENU_GET_CLASS(wm);
+
+	if (class->realize != NULL) {
+		return class->realize(wm);
+	} else {
+		return;
+	}
+}
+
+/* Drop everything that realize built, keeping only what's needed
+   to build it again.  Entries get signaled as removed. */
+void
+window_menu_unrealize (WindowMenu * wm)
+{
+	g_return_if_fail (IS_WINDOW_MENU(wm));
+
+	WindowMenuClass * class = WINDOW_MENU_GET_CLASS(wm);
+
+	if (class->unrealize != NULL) {
+		return class->unrealize(wm);
+	} else {
+		return;
+	}
+}
+
+gboolean
+window_menu_is_realized (WindowMenu * wm)
+{
+	g_return_val_if_fail (IS_WINDOW_MENU(wm), FALSE);
+
+	WindowMenuClass * class = WINDOW_MENU_GET_CLASS(wm);
+
+	if (class->is_realized != NULL) {
+		return class->is_realized(wm);
+	} else {
+		return TRUE;
+	}
+}
+
+/* An estimate of the memory the realized menus take, in bytes.
+   Menus that aren't realized don't count. */
+gsize
+window_menu_get_size (WindowMenu * wm)
+{
+	g_return_val_if_fail (IS_WINDOW_MENU(wm), 0);
+
+	WindowMenuClass * class = WINDOW_MENU_GET_CLASS(wm);
+
+	if (class->get_size != NULL && window_menu_is_realized(wm)) {
+		return class->get_size(wm);
+	} else {
+		return 0;
+	}
+}
+
+/* Tell the menus they're the ones on the panel now */
+void
+window_menu_focus (WindowMenu * wm)
+{
+	g_return_if_fail (IS_WINDOW_MENU(wm));
+
+	WindowMenuClass * class = WINDOW_MENU_GET_CLASS(wm);
+
+	if (class->focus != NULL) {
+		return class->focus(wm);
+	} else {
+		return;
+	}
+}
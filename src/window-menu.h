@@ -47,6 +47,10 @@ enum _WindowMenuStatus {
 	WINDOW_MENU_STATUS_ACTIVE
 };
 
+/* Rough cost of an item that has been built, the widgets and
+   the label, for the backends to estimate their size with */
+#define WINDOW_MENU_ITEM_SIZE  1024
+
 typedef struct _WindowMenu      WindowMenu;
 typedef struct _WindowMenuClass WindowMenuClass;
 
@@ -65,6 +69,17 @@ struct _WindowMenuClass {
 
 	void             (*entry_activate)   (WindowMenu * wm, IndicatorObjectEntry * entry, guint timestamp);
 
+	/* Backends that can defer building their menus until they are
+	   first needed implement these, others are always realized */
+	void             (*realize)          (WindowMenu * wm);
+	void             (*unrealize)        (WindowMenu * wm);
+	gboolean         (*is_realized)      (WindowMenu * wm);
+	gsize            (*get_size)         (WindowMenu * wm);
+
+	/* The menus are going on the panel for their window, backends
+	   that share widgets between windows point them back at it */
+	void             (*focus)            (WindowMenu * wm);
+
 	/* Signals */
 	void (*entry_added)    (WindowMenu * wm, IndicatorObjectEntry * entry, gpointer user_data);
 	void (*entry_removed)  (WindowMenu * wm, IndicatorObjectEntry * entry, gpointer user_data);
@@ -93,6 +108,12 @@ void window_menu_entry_restore (WindowMenu * wm, IndicatorObjectEntry * entry);
 
 void window_menu_entry_activate (WindowMenu * wm, IndicatorObjectEntry * entry, guint timestamp);
 
+void window_menu_realize (WindowMenu * wm);
+void window_menu_unrealize (WindowMenu * wm);
+gboolean window_menu_is_realized (WindowMenu * wm);
+gsize window_menu_get_size (WindowMenu * wm);
+void window_menu_focus (WindowMenu * wm);
+
 G_END_DECLS
 
 #endif
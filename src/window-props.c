@@ -0,0 +1,720 @@
+/*
+Asynchronous fetching of the window properties used to find menus.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gdk/gdkx.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+#include "window-props.h"
+#include "MwmUtil.h"
+
+/* We keep our own XCB connection next to the one GDK has so that
+   requests can be sent out without waiting on the answers.  All the
+   properties of a window are requested in one go and the replies are
+   collected from the main loop as they come in, so finding the menus
+   of a new window costs a single round trip. */
+
+enum {
+	PROP_UNIQUE_BUS_NAME,
+	PROP_APP_MENU_OBJECT_PATH,
+	PROP_MENUBAR_OBJECT_PATH,
+	PROP_APPLICATION_OBJECT_PATH,
+	PROP_WINDOW_OBJECT_PATH,
+	PROP_UNITY_OBJECT_PATH,
+	PROP_MOTIF_WM_HINTS,
+	N_PROPS
+};
+
+static const gchar * prop_names[N_PROPS] = {
+	"_GTK_UNIQUE_BUS_NAME",
+	"_GTK_APP_MENU_OBJECT_PATH",
+	"_GTK_MENUBAR_OBJECT_PATH",
+	"_GTK_APPLICATION_OBJECT_PATH",
+	"_GTK_WINDOW_OBJECT_PATH",
+	"_UNITY_OBJECT_PATH",
+	_XA_MOTIF_WM_HINTS
+};
+
+/* Longest string we'll take from a property, in 32-bit units */
+#define PROP_STRING_LENGTH   1024
+/* Number of longs in MotifWmHints */
+#define PROP_HINTS_LENGTH    5
+
+typedef struct _PropsRequest PropsRequest;
+struct _PropsRequest {
+	WindowProps * props;
+	xcb_get_property_cookie_t cookies[N_PROPS];
+	guint collected;
+	gboolean failed;
+	gboolean stale;
+	GCancellable * cancellable;
+	WindowPropsFunc callback;
+	gpointer user_data;
+	GDestroyNotify notify;
+};
+
+/* A reply someone else is waiting on, see window_props_await() */
+typedef struct _ReplyWait ReplyWait;
+struct _ReplyWait {
+	unsigned int sequence;
+	WindowPropsReplyFunc func;
+	gpointer user_data;
+};
+
+/* Someone else looking at the events, see window_props_add_event_func() */
+typedef struct _EventWatch EventWatch;
+struct _EventWatch {
+	WindowPropsEventFunc func;
+	gpointer user_data;
+};
+
+static xcb_connection_t * connection = NULL;
+static gboolean connection_failed = FALSE;
+static GSource * connection_source = NULL;
+static gboolean connection_buffered = FALSE;
+static xcb_atom_t atoms[N_PROPS];
+static GHashTable * cache = NULL;
+static GQueue requests = G_QUEUE_INIT;
+static GQueue waits = G_QUEUE_INIT;
+static GSList * watches = NULL;
+
+typedef struct _ConnectionSource ConnectionSource;
+struct _ConnectionSource {
+	GSource source;
+	GPollFD poll;
+};
+
+static gboolean connection_source_prepare (GSource * source, gint * timeout);
+static gboolean connection_source_check (GSource * source);
+static gboolean connection_source_dispatch (GSource * source, GSourceFunc callback, gpointer user_data);
+
+static GSourceFuncs connection_source_funcs = {
+	connection_source_prepare,
+	connection_source_check,
+	connection_source_dispatch,
+	NULL
+};
+
+/* Allocate a new empty set of properties */
+static WindowProps *
+window_props_new (guint xid)
+{
+	WindowProps * props = g_new0(WindowProps, 1);
+
+	props->xid = xid;
+	props->ref_count = 1;
+
+	return props;
+}
+
+WindowProps *
+window_props_ref (WindowProps * props)
+{
+	g_return_val_if_fail(props != NULL, NULL);
+
+	g_atomic_int_inc(&props->ref_count);
+
+	return props;
+}
+
+void
+window_props_unref (WindowProps * props)
+{
+	g_return_if_fail(props != NULL);
+
+	if (!g_atomic_int_dec_and_test(&props->ref_count)) {
+		return;
+	}
+
+	g_free(props->unique_bus_name);
+	g_free(props->app_menu_object_path);
+	g_free(props->menubar_object_path);
+	g_free(props->application_object_path);
+	g_free(props->window_object_path);
+	g_free(props->unity_object_path);
+	g_free(props);
+
+	return;
+}
+
+/* Tell whoever asked about the window and free the request */
+static void
+request_complete (PropsRequest * request)
+{
+	WindowProps * props = request->failed ? NULL : request->props;
+
+	if (props != NULL && !request->stale && cache != NULL) {
+		g_hash_table_insert(cache, GUINT_TO_POINTER(props->xid), window_props_ref(props));
+	}
+
+	if (request->callback != NULL && !g_cancellable_is_cancelled(request->cancellable)) {
+		request->callback(request->props->xid, props, request->user_data);
+	}
+
+	if (request->notify != NULL) {
+		request->notify(request->user_data);
+	}
+
+	g_clear_object(&request->cancellable);
+	window_props_unref(request->props);
+	g_free(request);
+
+	return;
+}
+
+/* Pull the value out of a property reply into our structure */
+static void
+request_store (PropsRequest * request, guint prop, xcb_get_property_reply_t * reply)
+{
+	WindowProps * props = request->props;
+
+	if (reply->type == XCB_ATOM_NONE) {
+		return;
+	}
+
+	if (prop == PROP_MOTIF_WM_HINTS) {
+		const uint32_t * hints = xcb_get_property_value(reply);
+
+		if (reply->format == 32 && reply->value_len >= 2 && hints[0] & MWM_HINTS_FUNCTIONS) {
+			props->has_functions = TRUE;
+			props->functions = hints[1];
+		}
+
+		return;
+	}
+
+	if (reply->format != 8 || xcb_get_property_value_length(reply) <= 0) {
+		return;
+	}
+
+	gchar * value = g_strndup(xcb_get_property_value(reply), xcb_get_property_value_length(reply));
+
+	switch (prop) {
+	case PROP_UNIQUE_BUS_NAME:
+		props->unique_bus_name = value;
+		break;
+	case PROP_APP_MENU_OBJECT_PATH:
+		props->app_menu_object_path = value;
+		break;
+	case PROP_MENUBAR_OBJECT_PATH:
+		props->menubar_object_path = value;
+		break;
+	case PROP_APPLICATION_OBJECT_PATH:
+		props->application_object_path = value;
+		break;
+	case PROP_WINDOW_OBJECT_PATH:
+		props->window_object_path = value;
+		break;
+	case PROP_UNITY_OBJECT_PATH:
+		props->unity_object_path = value;
+		break;
+	default:
+		g_free(value);
+		break;
+	}
+
+	return;
+}
+
+/* Grab all the replies that have arrived for the request, returns
+   TRUE once it has all of them. */
+static gboolean
+request_collect (PropsRequest * request)
+{
+	while (request->collected < N_PROPS) {
+		xcb_get_property_reply_t * reply = NULL;
+		xcb_generic_error_t * error = NULL;
+
+		if (!xcb_poll_for_reply(connection, request->cookies[request->collected].sequence, (void **)&reply, &error)) {
+			return FALSE;
+		}
+
+		if (error != NULL) {
+			/* Most likely the window went away already */
+			request->failed = TRUE;
+			free(error);
+		}
+
+		if (reply != NULL) {
+			request_store(request, request->collected, reply);
+			free(reply);
+		}
+
+		request->collected++;
+	}
+
+	return TRUE;
+}
+
+/* Drop what we know about a window, either because it changed or
+   because it's gone. */
+static void
+invalidate_window (guint xid)
+{
+	GList * lrequest;
+
+	g_hash_table_remove(cache, GUINT_TO_POINTER(xid));
+
+	/* Anything in flight might have been read before the change */
+	for (lrequest = requests.head; lrequest != NULL; lrequest = g_list_next(lrequest)) {
+		PropsRequest * request = lrequest->data;
+
+		if (request->props->xid == xid) {
+			request->stale = TRUE;
+		}
+	}
+
+	return;
+}
+
+/* Hand out the replies others are waiting on, in order, returns
+   TRUE if any of them came in */
+static gboolean
+waits_collect (void)
+{
+	gboolean progress = FALSE;
+
+	while (!g_queue_is_empty(&waits)) {
+		ReplyWait * wait = g_queue_peek_head(&waits);
+		void * reply = NULL;
+		xcb_generic_error_t * error = NULL;
+
+		if (!xcb_poll_for_reply(connection, wait->sequence, &reply, &error)) {
+			break;
+		}
+
+		g_queue_pop_head(&waits);
+		wait->func(reply, error, wait->user_data);
+
+		free(reply);
+		free(error);
+		g_free(wait);
+		progress = TRUE;
+	}
+
+	return progress;
+}
+
+/* Look at an event coming from the server */
+static void
+handle_event (xcb_generic_event_t * event)
+{
+	GSList * lwatch;
+
+	for (lwatch = watches; lwatch != NULL; lwatch = g_slist_next(lwatch)) {
+		EventWatch * watch = lwatch->data;
+		watch->func(event, watch->user_data);
+	}
+
+	switch (event->response_type & ~0x80) {
+	case XCB_PROPERTY_NOTIFY: {
+		xcb_property_notify_event_t * notify = (xcb_property_notify_event_t *)event;
+		guint prop;
+
+		for (prop = 0; prop < N_PROPS; prop++) {
+			if (atoms[prop] == notify->atom) {
+				invalidate_window(notify->window);
+				break;
+			}
+		}
+		break;
+	}
+	case XCB_DESTROY_NOTIFY: {
+		xcb_destroy_notify_event_t * notify = (xcb_destroy_notify_event_t *)event;
+		invalidate_window(notify->window);
+		break;
+	}
+	default:
+		/* Errors from selecting input on windows that are already
+		   gone end up here, along with everything else we don't
+		   care about. */
+		break;
+	}
+
+	return;
+}
+
+/* The connection is broken, fail everyone and stop trying */
+static void
+connection_lost (void)
+{
+	PropsRequest * request;
+
+	g_warning("Lost the XCB connection for window properties, falling back to synchronous lookups");
+
+	if (connection_source != NULL) {
+		g_source_destroy(connection_source);
+		g_source_unref(connection_source);
+		connection_source = NULL;
+	}
+	connection_buffered = FALSE;
+
+	while ((request = g_queue_pop_head(&requests)) != NULL) {
+		request->failed = TRUE;
+		request_complete(request);
+	}
+
+	ReplyWait * wait;
+	while ((wait = g_queue_pop_head(&waits)) != NULL) {
+		wait->func(NULL, NULL, wait->user_data);
+		g_free(wait);
+	}
+
+	g_clear_pointer(&cache, g_hash_table_destroy);
+
+	xcb_disconnect(connection);
+	connection = NULL;
+	connection_failed = TRUE;
+
+	return;
+}
+
+/* XCB reads whatever the server has sent while flushing or waiting
+   on a reply, which leaves it in XCB's buffer and not on the socket.
+   Call this after anything that might have done that so the source
+   dispatches even though the socket won't poll as readable. */
+static void
+connection_flush (void)
+{
+	xcb_flush(connection);
+	connection_buffered = TRUE;
+
+	return;
+}
+
+static gboolean
+connection_source_prepare (GSource * source, gint * timeout)
+{
+	*timeout = -1;
+	return connection_buffered;
+}
+
+static gboolean
+connection_source_check (GSource * source)
+{
+	ConnectionSource * csource = (ConnectionSource *)source;
+
+	return connection_buffered || csource->poll.revents != 0;
+}
+
+/* Something is readable on the connection or already sitting in
+   XCB's buffer, deal with events and complete as many requests as
+   we can. */
+static gboolean
+connection_source_dispatch (GSource * source, GSourceFunc callback, gpointer user_data)
+{
+	gboolean progress = TRUE;
+
+	connection_buffered = FALSE;
+
+	/* Reading a reply can pull events off the socket and the other
+	   way around, so keep going until neither gets us anywhere. */
+	while (progress && !xcb_connection_has_error(connection)) {
+		xcb_generic_event_t * event;
+
+		progress = FALSE;
+
+		while ((event = xcb_poll_for_event(connection)) != NULL) {
+			handle_event(event);
+			free(event);
+			progress = TRUE;
+		}
+
+		while (!g_queue_is_empty(&requests)) {
+			PropsRequest * request = g_queue_peek_head(&requests);
+
+			if (!request_collect(request)) {
+				break;
+			}
+
+			g_queue_pop_head(&requests);
+			request_complete(request);
+			progress = TRUE;
+		}
+
+		if (waits_collect()) {
+			progress = TRUE;
+		}
+	}
+
+	if (xcb_connection_has_error(connection)) {
+		connection_lost();
+		return G_SOURCE_REMOVE;
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+/* Make sure we've got a connection to the same display as GDK
+   and know the atoms that we're looking for. */
+static gboolean
+connection_ensure (void)
+{
+	if (connection != NULL) {
+		return TRUE;
+	}
+
+	if (connection_failed) {
+		return FALSE;
+	}
+
+	GdkDisplay * display = gdk_display_get_default();
+	if (display == NULL || !GDK_IS_X11_DISPLAY(display)) {
+		connection_failed = TRUE;
+		return FALSE;
+	}
+
+	connection = xcb_connect(gdk_display_get_name(display), NULL);
+	if (xcb_connection_has_error(connection)) {
+		g_warning("Unable to connect XCB to '%s', window properties will be read synchronously", gdk_display_get_name(display));
+		xcb_disconnect(connection);
+		connection = NULL;
+		connection_failed = TRUE;
+		return FALSE;
+	}
+
+	/* The atoms are only looked up once, so it's okay to wait on
+	   them here. */
+	xcb_intern_atom_cookie_t cookies[N_PROPS];
+	guint prop;
+
+	for (prop = 0; prop < N_PROPS; prop++) {
+		cookies[prop] = xcb_intern_atom(connection, FALSE, strlen(prop_names[prop]), prop_names[prop]);
+	}
+
+	for (prop = 0; prop < N_PROPS; prop++) {
+		xcb_intern_atom_reply_t * reply = xcb_intern_atom_reply(connection, cookies[prop], NULL);
+
+		atoms[prop] = XCB_ATOM_NONE;
+		if (reply != NULL) {
+			atoms[prop] = reply->atom;
+			free(reply);
+		}
+	}
+
+	cache = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)window_props_unref);
+	connection_source = g_source_new(&connection_source_funcs, sizeof(ConnectionSource));
+	ConnectionSource * csource = (ConnectionSource *)connection_source;
+	csource->poll.fd = xcb_get_file_descriptor(connection);
+	csource->poll.events = G_IO_IN | G_IO_HUP | G_IO_ERR;
+	g_source_add_poll(connection_source, &csource->poll);
+	g_source_attach(connection_source, NULL);
+
+	/* Waiting on the atoms may have read events along with them */
+	connection_buffered = TRUE;
+
+	return TRUE;
+}
+
+/**
+ * window_props_fetch:
+ * @xid: The window to read the properties of
+ * @cancellable: (allow-none): Stops @callback from being called
+ * @callback: Called with the properties once they're all in
+ * @user_data: Data for @callback
+ * @notify: (allow-none): Frees @user_data, always called
+ *
+ * Sends out the requests for all the menu related properties of
+ * @xid at once.  @callback gets a NULL set of properties if they
+ * couldn't be read, most likely because the window has gone away.
+ * The properties are also kept around for #window_props_lookup until
+ * they change on the window.
+ *
+ * Return value: FALSE if properties can't be fetched asynchronously,
+ *   in which case nothing gets called.
+ */
+gboolean
+window_props_fetch (guint xid, GCancellable * cancellable, WindowPropsFunc callback, gpointer user_data, GDestroyNotify notify)
+{
+	g_return_val_if_fail(xid != 0, FALSE);
+
+	if (!connection_ensure()) {
+		return FALSE;
+	}
+
+	PropsRequest * request = g_new0(PropsRequest, 1);
+	request->props = window_props_new(xid);
+	request->callback = callback;
+	request->user_data = user_data;
+	request->notify = notify;
+	if (cancellable != NULL) {
+		request->cancellable = g_object_ref(cancellable);
+	}
+
+	/* Watch before reading so that we can't miss a change in between */
+	const uint32_t event_mask = XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+	xcb_change_window_attributes(connection, xid, XCB_CW_EVENT_MASK, &event_mask);
+
+	guint prop;
+	for (prop = 0; prop < N_PROPS; prop++) {
+		request->cookies[prop] = xcb_get_property(connection,
+		                                          FALSE,
+		                                          xid,
+		                                          atoms[prop],
+		                                          XCB_GET_PROPERTY_TYPE_ANY,
+		                                          0,
+		                                          prop == PROP_MOTIF_WM_HINTS ? PROP_HINTS_LENGTH : PROP_STRING_LENGTH);
+	}
+
+	connection_flush();
+
+	g_queue_push_tail(&requests, request);
+
+	return TRUE;
+}
+
+/**
+ * window_props_lookup:
+ * @xid: The window to look for
+ *
+ * Return value: (transfer none): The properties of @xid if they've
+ *   been fetched and haven't changed since, otherwise NULL.
+ */
+WindowProps *
+window_props_lookup (guint xid)
+{
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	return g_hash_table_lookup(cache, GUINT_TO_POINTER(xid));
+}
+
+/**
+ * window_props_forget:
+ * @xid: The window that is going away
+ *
+ * Drops the cached properties for @xid and stops watching it.
+ */
+void
+window_props_forget (guint xid)
+{
+	if (connection == NULL) {
+		return;
+	}
+
+	invalidate_window(xid);
+
+	const uint32_t event_mask = XCB_EVENT_MASK_NO_EVENT;
+	xcb_change_window_attributes(connection, xid, XCB_CW_EVENT_MASK, &event_mask);
+	connection_flush();
+
+	return;
+}
+
+/**
+ * window_props_connection:
+ *
+ * Connects to the X server if that hasn't happened yet.  Others can
+ * send their own requests on the connection but shouldn't wait on
+ * the replies, use #window_props_await for that.
+ *
+ * Return value: (transfer none): The connection used for fetching
+ *   properties, or NULL if there isn't one.
+ */
+xcb_connection_t *
+window_props_connection (void)
+{
+	if (!connection_ensure()) {
+		return NULL;
+	}
+
+	return connection;
+}
+
+/**
+ * window_props_add_event_func:
+ * @func: Called with every event on the connection
+ * @user_data: Data for @func
+ *
+ * Lets @func look at the events before the properties are
+ * invalidated.  Events are only sent for windows where someone
+ * selected them on this connection.
+ */
+void
+window_props_add_event_func (WindowPropsEventFunc func, gpointer user_data)
+{
+	g_return_if_fail(func != NULL);
+
+	EventWatch * watch = g_new0(EventWatch, 1);
+	watch->func = func;
+	watch->user_data = user_data;
+
+	watches = g_slist_append(watches, watch);
+
+	return;
+}
+
+/**
+ * window_props_remove_event_func:
+ * @func: Function passed to #window_props_add_event_func
+ * @user_data: Data passed to #window_props_add_event_func
+ *
+ * Stops calling @func with events.
+ */
+void
+window_props_remove_event_func (WindowPropsEventFunc func, gpointer user_data)
+{
+	GSList * lwatch;
+
+	for (lwatch = watches; lwatch != NULL; lwatch = g_slist_next(lwatch)) {
+		EventWatch * watch = lwatch->data;
+
+		if (watch->func == func && watch->user_data == user_data) {
+			watches = g_slist_delete_link(watches, lwatch);
+			g_free(watch);
+			return;
+		}
+	}
+
+	return;
+}
+
+/**
+ * window_props_await:
+ * @sequence: The sequence number of a request sent on the connection
+ * @func: Called with the reply
+ * @user_data: Data for @func
+ *
+ * Collects the reply to @sequence from the main loop like the
+ * property replies are.  Requests have to be awaited in the order
+ * they were sent.  The connection is flushed.
+ */
+void
+window_props_await (unsigned int sequence, WindowPropsReplyFunc func, gpointer user_data)
+{
+	g_return_if_fail(func != NULL);
+	g_return_if_fail(connection != NULL);
+
+	ReplyWait * wait = g_new0(ReplyWait, 1);
+	wait->sequence = sequence;
+	wait->func = func;
+	wait->user_data = user_data;
+
+	g_queue_push_tail(&waits, wait);
+	connection_flush();
+
+	return;
+}
@@ -0,0 +1,76 @@
+/*
+Asynchronous fetching of the window properties used to find menus.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __WINDOW_PROPS_H__
+#define __WINDOW_PROPS_H__
+
+#include <gio/gio.h>
+#include <xcb/xcb.h>
+
+G_BEGIN_DECLS
+
+typedef struct _WindowProps WindowProps;
+struct _WindowProps {
+	guint xid;
+
+	/* UTF-8 properties, NULL when not set on the window */
+	gchar * unique_bus_name;          /* _GTK_UNIQUE_BUS_NAME */
+	gchar * app_menu_object_path;     /* _GTK_APP_MENU_OBJECT_PATH */
+	gchar * menubar_object_path;      /* _GTK_MENUBAR_OBJECT_PATH */
+	gchar * application_object_path;  /* _GTK_APPLICATION_OBJECT_PATH */
+	gchar * window_object_path;       /* _GTK_WINDOW_OBJECT_PATH */
+	gchar * unity_object_path;        /* _UNITY_OBJECT_PATH */
+
+	/* _MOTIF_WM_HINTS */
+	gboolean has_functions;
+	guint functions;
+
+	/* < private > */
+	gint ref_count;
+};
+
+typedef void (*WindowPropsFunc) (guint xid, WindowProps * props, gpointer user_data);
+
+/* For others sharing the connection, @reply and @error are owned by
+   the caller and are both NULL when the connection was lost */
+typedef void (*WindowPropsEventFunc) (xcb_generic_event_t * event, gpointer user_data);
+typedef void (*WindowPropsReplyFunc) (void * reply, xcb_generic_error_t * error, gpointer user_data);
+
+gboolean      window_props_fetch   (guint xid,
+                                    GCancellable * cancellable,
+                                    WindowPropsFunc callback,
+                                    gpointer user_data,
+                                    GDestroyNotify notify);
+WindowProps * window_props_lookup  (guint xid);
+void          window_props_forget  (guint xid);
+
+WindowProps * window_props_ref     (WindowProps * props);
+void          window_props_unref   (WindowProps * props);
+
+xcb_connection_t * window_props_connection  (void);
+void          window_props_add_event_func    (WindowPropsEventFunc func,
+                                              gpointer user_data);
+void          window_props_remove_event_func (WindowPropsEventFunc func,
+                                              gpointer user_data);
+void          window_props_await   (unsigned int sequence,
+                                    WindowPropsReplyFunc func,
+                                    gpointer user_data);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,419 @@
+/*
+Window tracking through bamfdaemon.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <libbamf/libbamf.h>
+
+#include "window-tracker-bamf.h"
+
+/* Private parts */
+
+typedef struct _WindowTrackerBamfPrivate WindowTrackerBamfPrivate;
+struct _WindowTrackerBamfPrivate {
+	BamfMatcher * matcher;
+	/* BAMF windows we've seen opened, by XID */
+	GHashTable * windows;
+	guint active;
+};
+
+#define WINDOW_TRACKER_BAMF_GET_PRIVATE(o) \
+(G_TYPE_INSTANCE_GET_PRIVATE ((o), WINDOW_TRACKER_BAMF_TYPE, WindowTrackerBamfPrivate))
+
+/* Prototypes */
+
+static void window_tracker_bamf_class_init (WindowTrackerBamfClass *klass);
+static void window_tracker_bamf_init       (WindowTrackerBamf *self);
+static void window_tracker_bamf_dispose    (GObject *object);
+
+static guint                   get_active_window    (WindowTracker * tracker);
+static GArray *                get_windows          (WindowTracker * tracker);
+static gboolean                has_window           (WindowTracker * tracker,
+                                                     guint xid);
+static WindowTrackerWindowType get_window_type      (WindowTracker * tracker,
+                                                     guint xid);
+static guint                   get_transient        (WindowTracker * tracker,
+                                                     guint xid);
+static gchar *                 get_window_prop      (WindowTracker * tracker,
+                                                     guint xid,
+                                                     const gchar * name);
+static gchar *                 get_desktop_file     (WindowTracker * tracker,
+                                                     guint xid);
+static gboolean                get_show_menu_stubs  (WindowTracker * tracker,
+                                                     guint xid);
+
+static void view_opened            (BamfMatcher * matcher,
+                                    BamfView * view,
+                                    gpointer user_data);
+static void view_closed            (BamfMatcher * matcher,
+                                    BamfView * view,
+                                    gpointer user_data);
+static void active_window_changed  (BamfMatcher * matcher,
+                                    BamfView * oldview,
+                                    BamfView * newview,
+                                    gpointer user_data);
+
+G_DEFINE_TYPE (WindowTrackerBamf, window_tracker_bamf, WINDOW_TRACKER_TYPE);
+
+/* Build the one-time class */
+static void
+window_tracker_bamf_class_init (WindowTrackerBamfClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (WindowTrackerBamfPrivate));
+
+	object_class->dispose = window_tracker_bamf_dispose;
+
+	WindowTrackerClass * tracker_class = WINDOW_TRACKER_CLASS(klass);
+	tracker_class->get_active_window = get_active_window;
+	tracker_class->get_windows = get_windows;
+	tracker_class->has_window = has_window;
+	tracker_class->get_window_type = get_window_type;
+	tracker_class->get_transient = get_transient;
+	tracker_class->get_window_prop = get_window_prop;
+	tracker_class->get_desktop_file = get_desktop_file;
+	tracker_class->get_show_menu_stubs = get_show_menu_stubs;
+
+	return;
+}
+
+/* Initialize the per-instance data */
+static void
+window_tracker_bamf_init (WindowTrackerBamf *self)
+{
+	WindowTrackerBamfPrivate * priv = WINDOW_TRACKER_BAMF_GET_PRIVATE(self);
+
+	priv->windows = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
+
+	priv->matcher = bamf_matcher_get_default();
+	if (priv->matcher == NULL) {
+		/* we don't want to exit out of Unity -- but this
+		   should really never happen */
+		g_warning("Unable to get BAMF matcher, can not watch applications switch!");
+		return;
+	}
+
+	g_signal_connect(G_OBJECT(priv->matcher), "active-window-changed", G_CALLBACK(active_window_changed), self);
+	g_signal_connect(G_OBJECT(priv->matcher), "view-opened", G_CALLBACK(view_opened), self);
+	g_signal_connect(G_OBJECT(priv->matcher), "view-closed", G_CALLBACK(view_closed), self);
+
+	/* The windows that were there before us */
+	GList * windows = bamf_matcher_get_windows(priv->matcher);
+	GList * lwindow;
+	for (lwindow = windows; lwindow != NULL; lwindow = g_list_next(lwindow)) {
+		BamfWindow * window = BAMF_WINDOW(lwindow->data);
+		guint xid = bamf_window_get_xid(window);
+
+		if (xid != 0) {
+			g_hash_table_insert(priv->windows, GUINT_TO_POINTER(xid), g_object_ref(window));
+		}
+	}
+	g_list_free(windows);
+
+	/* Note: Does not cause ref */
+	BamfWindow * active = bamf_matcher_get_active_window(priv->matcher);
+	if (active != NULL) {
+		priv->active = bamf_window_get_xid(active);
+	}
+
+	return;
+}
+
+/* Stop listening to the matcher and let go of the windows */
+static void
+window_tracker_bamf_dispose (GObject *object)
+{
+	WindowTrackerBamfPrivate * priv = WINDOW_TRACKER_BAMF_GET_PRIVATE(object);
+
+	if (priv->matcher != NULL) {
+		g_signal_handlers_disconnect_by_data(priv->matcher, object);
+		g_clear_object(&priv->matcher);
+	}
+
+	g_clear_pointer(&priv->windows, g_hash_table_destroy);
+
+	G_OBJECT_CLASS (window_tracker_bamf_parent_class)->dispose (object);
+	return;
+}
+
+/* Find the BAMF Window that is associated with that XID.  Usually
+   we've seen it open already, otherwise this requires a bit of
+   searching, don't do it too often */
+static BamfWindow *
+lookup_window (WindowTrackerBamf * tracker, guint xid)
+{
+	WindowTrackerBamfPrivate * priv = WINDOW_TRACKER_BAMF_GET_PRIVATE(tracker);
+	BamfWindow * newwindow = NULL;
+
+	if (xid == 0 || priv->windows == NULL || priv->matcher == NULL) {
+		return NULL;
+	}
+
+	newwindow = g_hash_table_lookup(priv->windows, GUINT_TO_POINTER(xid));
+	if (newwindow != NULL && !bamf_view_is_closed(BAMF_VIEW(newwindow))) {
+		return newwindow;
+	}
+
+	newwindow = bamf_matcher_get_window_for_xid(priv->matcher, xid);
+
+	if (!BAMF_IS_WINDOW(newwindow)) {
+		BamfApplication *application = bamf_matcher_get_application_for_xid(priv->matcher, xid);
+		GList * children = bamf_view_peek_children (BAMF_VIEW (application));
+		GList * l;
+
+		newwindow = NULL;
+
+		for (l = children; l; l = l->next) {
+			if (!BAMF_IS_WINDOW(l->data)) {
+				continue;
+			}
+
+			BamfWindow * testwindow = BAMF_WINDOW(l->data);
+
+			if (xid == bamf_window_get_xid(testwindow)) {
+				newwindow = testwindow;
+				break;
+			}
+		}
+	}
+
+	/* Don't search for it again */
+	if (newwindow != NULL) {
+		g_hash_table_insert(priv->windows, GUINT_TO_POINTER(xid), g_object_ref(newwindow));
+	}
+
+	return newwindow;
+}
+
+static BamfApplication *
+lookup_application (WindowTrackerBamf * tracker, guint xid)
+{
+	WindowTrackerBamfPrivate * priv = WINDOW_TRACKER_BAMF_GET_PRIVATE(tracker);
+	BamfWindow * window = lookup_window(tracker, xid);
+
+	if (window == NULL) {
+		return NULL;
+	}
+
+	return bamf_matcher_get_application_for_window(priv->matcher, window);
+}
+
+/* A view showed up on BAMF, we only care about windows */
+static void
+view_opened (BamfMatcher * matcher, BamfView * view, gpointer user_data)
+{
+	if (!BAMF_IS_WINDOW(view)) {
+		return;
+	}
+
+	WindowTrackerBamfPrivate * priv = WINDOW_TRACKER_BAMF_GET_PRIVATE(user_data);
+	BamfWindow * window = BAMF_WINDOW(view);
+	guint xid = bamf_window_get_xid(window);
+
+	if (xid == 0) {
+		return;
+	}
+
+	g_hash_table_insert(priv->windows, GUINT_TO_POINTER(xid), g_object_ref(window));
+	g_signal_emit_by_name(user_data, WINDOW_TRACKER_SIGNAL_WINDOW_OPENED, xid);
+
+	return;
+}
+
+static void
+view_closed (BamfMatcher * matcher, BamfView * view, gpointer user_data)
+{
+	if (!BAMF_IS_WINDOW(view)) {
+		return;
+	}
+
+	WindowTrackerBamfPrivate * priv = WINDOW_TRACKER_BAMF_GET_PRIVATE(user_data);
+	BamfWindow * window = BAMF_WINDOW(view);
+	guint xid = bamf_window_get_xid(window);
+
+	if (xid == 0) {
+		return;
+	}
+
+	if (priv->active == xid) {
+		priv->active = 0;
+	}
+
+	/* Keep the window alive until everyone has heard it's gone */
+	g_object_ref(window);
+
+	if (g_hash_table_lookup(priv->windows, GUINT_TO_POINTER(xid)) == window) {
+		g_hash_table_remove(priv->windows, GUINT_TO_POINTER(xid));
+	}
+
+	g_signal_emit_by_name(user_data, WINDOW_TRACKER_SIGNAL_WINDOW_CLOSED, xid);
+
+	g_object_unref(window);
+
+	return;
+}
+
+static void
+active_window_changed (BamfMatcher * matcher, BamfView * oldview, BamfView * newview, gpointer user_data)
+{
+	WindowTrackerBamfPrivate * priv = WINDOW_TRACKER_BAMF_GET_PRIVATE(user_data);
+	guint oldxid = priv->active;
+	guint newxid = 0;
+
+	if (newview != NULL && !BAMF_IS_WINDOW(newview)) {
+		g_warning("Active window changed to View thats not a window.");
+	} else if (newview != NULL) {
+		newxid = bamf_window_get_xid(BAMF_WINDOW(newview));
+
+		if (newxid != 0 && !g_hash_table_contains(priv->windows, GUINT_TO_POINTER(newxid))) {
+			g_hash_table_insert(priv->windows, GUINT_TO_POINTER(newxid), g_object_ref(newview));
+		}
+	}
+
+	priv->active = newxid;
+	g_signal_emit_by_name(user_data, WINDOW_TRACKER_SIGNAL_ACTIVE_WINDOW_CHANGED, oldxid, newxid);
+
+	return;
+}
+
+static guint
+get_active_window (WindowTracker * tracker)
+{
+	WindowTrackerBamfPrivate * priv = WINDOW_TRACKER_BAMF_GET_PRIVATE(tracker);
+	return priv->active;
+}
+
+static GArray *
+get_windows (WindowTracker * tracker)
+{
+	WindowTrackerBamfPrivate * priv = WINDOW_TRACKER_BAMF_GET_PRIVATE(tracker);
+	GArray * xids = g_array_new(FALSE, FALSE, sizeof(guint));
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (priv->windows == NULL) {
+		return xids;
+	}
+
+	g_hash_table_iter_init(&iter, priv->windows);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		if (!bamf_view_is_closed(BAMF_VIEW(value))) {
+			guint xid = GPOINTER_TO_UINT(key);
+			g_array_append_val(xids, xid);
+		}
+	}
+
+	return xids;
+}
+
+static gboolean
+has_window (WindowTracker * tracker, guint xid)
+{
+	BamfWindow * window = lookup_window(WINDOW_TRACKER_BAMF(tracker), xid);
+	return window != NULL && !bamf_view_is_closed(BAMF_VIEW(window));
+}
+
+static WindowTrackerWindowType
+get_window_type (WindowTracker * tracker, guint xid)
+{
+	BamfWindow * window = lookup_window(WINDOW_TRACKER_BAMF(tracker), xid);
+
+	if (window == NULL) {
+		return WINDOW_TRACKER_WINDOW_OTHER;
+	}
+
+	switch (bamf_window_get_window_type(window)) {
+	case BAMF_WINDOW_NORMAL:
+		return WINDOW_TRACKER_WINDOW_NORMAL;
+	case BAMF_WINDOW_DESKTOP:
+		return WINDOW_TRACKER_WINDOW_DESKTOP;
+	case BAMF_WINDOW_DOCK:
+		return WINDOW_TRACKER_WINDOW_DOCK;
+	case BAMF_WINDOW_DIALOG:
+		return WINDOW_TRACKER_WINDOW_DIALOG;
+	default:
+		return WINDOW_TRACKER_WINDOW_OTHER;
+	}
+}
+
+static guint
+get_transient (WindowTracker * tracker, guint xid)
+{
+	BamfWindow * window = lookup_window(WINDOW_TRACKER_BAMF(tracker), xid);
+
+	if (window == NULL) {
+		return 0;
+	}
+
+	BamfWindow * parent = bamf_window_get_transient(window);
+	if (parent == NULL) {
+		return 0;
+	}
+
+	return bamf_window_get_xid(parent);
+}
+
+static gchar *
+get_window_prop (WindowTracker * tracker, guint xid, const gchar * name)
+{
+	BamfWindow * window = lookup_window(WINDOW_TRACKER_BAMF(tracker), xid);
+
+	if (window == NULL) {
+		return NULL;
+	}
+
+	return bamf_window_get_utf8_prop(window, name);
+}
+
+static gchar *
+get_desktop_file (WindowTracker * tracker, guint xid)
+{
+	BamfApplication * app = lookup_application(WINDOW_TRACKER_BAMF(tracker), xid);
+
+	if (app == NULL) {
+		return NULL;
+	}
+
+	return g_strdup(bamf_application_get_desktop_file(app));
+}
+
+static gboolean
+get_show_menu_stubs (WindowTracker * tracker, guint xid)
+{
+	BamfApplication * app = lookup_application(WINDOW_TRACKER_BAMF(tracker), xid);
+
+	if (app == NULL) {
+		return TRUE;
+	}
+
+	return bamf_application_get_show_menu_stubs(app);
+}
+
+/**************************
+  API
+ **************************/
+
+/* Follows the windows through the default BAMF matcher */
+WindowTrackerBamf *
+window_tracker_bamf_new (void)
+{
+	return g_object_new(WINDOW_TRACKER_BAMF_TYPE, NULL);
+}
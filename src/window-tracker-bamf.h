@@ -0,0 +1,49 @@
+/*
+Window tracking through bamfdaemon.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __WINDOW_TRACKER_BAMF_H__
+#define __WINDOW_TRACKER_BAMF_H__
+
+#include "window-tracker.h"
+
+G_BEGIN_DECLS
+
+#define WINDOW_TRACKER_BAMF_TYPE            (window_tracker_bamf_get_type ())
+#define WINDOW_TRACKER_BAMF(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), WINDOW_TRACKER_BAMF_TYPE, WindowTrackerBamf))
+#define WINDOW_TRACKER_BAMF_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), WINDOW_TRACKER_BAMF_TYPE, WindowTrackerBamfClass))
+#define IS_WINDOW_TRACKER_BAMF(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), WINDOW_TRACKER_BAMF_TYPE))
+#define IS_WINDOW_TRACKER_BAMF_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), WINDOW_TRACKER_BAMF_TYPE))
+#define WINDOW_TRACKER_BAMF_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), WINDOW_TRACKER_BAMF_TYPE, WindowTrackerBamfClass))
+
+typedef struct _WindowTrackerBamf      WindowTrackerBamf;
+typedef struct _WindowTrackerBamfClass WindowTrackerBamfClass;
+
+struct _WindowTrackerBamfClass {
+	WindowTrackerClass parent_class;
+};
+
+struct _WindowTrackerBamf {
+	WindowTracker parent;
+};
+
+GType window_tracker_bamf_get_type (void);
+WindowTrackerBamf * window_tracker_bamf_new (void);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,740 @@
+/*
+Window tracking straight from the EWMH properties on the root window.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <gdk/gdkx.h>
+#include <xcb/xcb.h>
+
+#include "window-tracker-ewmh.h"
+#include "window-props.h"
+
+/* The window manager keeps the list of client windows and the focused
+   one on the root window, so we watch that and read the type and the
+   transient parent of each new window.  Everything goes through the
+   XCB connection that window-props.c has and the replies are collected
+   from the main loop, a focus change costs one round trip to the X
+   server and nothing else. */
+
+enum {
+	ATOM_NET_ACTIVE_WINDOW,
+	ATOM_NET_CLIENT_LIST,
+	ATOM_NET_WM_WINDOW_TYPE,
+	ATOM_NET_WM_WINDOW_TYPE_NORMAL,
+	ATOM_NET_WM_WINDOW_TYPE_DESKTOP,
+	ATOM_NET_WM_WINDOW_TYPE_DOCK,
+	ATOM_NET_WM_WINDOW_TYPE_DIALOG,
+	N_ATOMS
+};
+
+static const gchar * atom_names[N_ATOMS] = {
+	"_NET_ACTIVE_WINDOW",
+	"_NET_CLIENT_LIST",
+	"_NET_WM_WINDOW_TYPE",
+	"_NET_WM_WINDOW_TYPE_NORMAL",
+	"_NET_WM_WINDOW_TYPE_DESKTOP",
+	"_NET_WM_WINDOW_TYPE_DOCK",
+	"_NET_WM_WINDOW_TYPE_DIALOG"
+};
+
+/* Longest client list we'll read, in windows */
+#define CLIENT_LIST_LENGTH   4096
+/* Most window types we'll look at on a window */
+#define WINDOW_TYPE_LENGTH   16
+/* Property libbamf reads the desktop file from */
+#define DESKTOP_FILE_PROP    "_BAMF_DESKTOP_FILE"
+
+/* Replies a new window is waiting on before it's announced */
+enum {
+	PENDING_TYPE      = 1 << 0,
+	PENDING_TRANSIENT = 1 << 1
+};
+
+typedef struct _EwmhWindow EwmhWindow;
+struct _EwmhWindow {
+	/* Tells this window apart from an earlier one with the same XID */
+	guint serial;
+	WindowTrackerWindowType type;
+	gboolean typed;
+	guint transient;
+	guint pending;
+	gboolean announced;
+};
+
+/* Private parts */
+
+typedef struct _WindowTrackerEwmhPrivate WindowTrackerEwmhPrivate;
+struct _WindowTrackerEwmhPrivate {
+	xcb_window_t root;
+	xcb_atom_t atoms[N_ATOMS];
+	/* Client windows by XID, see EwmhWindow */
+	GHashTable * windows;
+	guint active;
+	/* Focused according to the window manager, waiting on the
+	   window to be announced before it's passed on */
+	guint wanted_active;
+	guint last_serial;
+};
+
+#define WINDOW_TRACKER_EWMH_GET_PRIVATE(o) \
+(G_TYPE_INSTANCE_GET_PRIVATE ((o), WINDOW_TRACKER_EWMH_TYPE, WindowTrackerEwmhPrivate))
+
+/* A reply on its way, holds a ref on the tracker.  Replies about
+   a client window only count for the EwmhWindow with @serial. */
+typedef struct _EwmhWait EwmhWait;
+struct _EwmhWait {
+	WindowTrackerEwmh * tracker;
+	guint xid;
+	guint serial;
+};
+
+/* Prototypes */
+
+static void window_tracker_ewmh_class_init (WindowTrackerEwmhClass *klass);
+static void window_tracker_ewmh_init       (WindowTrackerEwmh *self);
+static void window_tracker_ewmh_dispose    (GObject *object);
+static void window_tracker_ewmh_finalize   (GObject *object);
+
+static guint                   get_active_window    (WindowTracker * tracker);
+static GArray *                get_windows          (WindowTracker * tracker);
+static gboolean                has_window           (WindowTracker * tracker,
+                                                     guint xid);
+static WindowTrackerWindowType get_window_type      (WindowTracker * tracker,
+                                                     guint xid);
+static guint                   get_transient        (WindowTracker * tracker,
+                                                     guint xid);
+static gchar *                 get_window_prop      (WindowTracker * tracker,
+                                                     guint xid,
+                                                     const gchar * name);
+static gchar *                 get_desktop_file     (WindowTracker * tracker,
+                                                     guint xid);
+
+static void handle_event           (xcb_generic_event_t * event,
+                                    gpointer user_data);
+static void fetch_client_list      (WindowTrackerEwmh * tracker);
+static void fetch_active_window    (WindowTrackerEwmh * tracker);
+static void fetch_window_type      (WindowTrackerEwmh * tracker,
+                                    guint xid,
+                                    EwmhWindow * window);
+static void fetch_transient        (WindowTrackerEwmh * tracker,
+                                    guint xid,
+                                    EwmhWindow * window);
+
+G_DEFINE_TYPE (WindowTrackerEwmh, window_tracker_ewmh, WINDOW_TRACKER_TYPE);
+
+/* Build the one-time class */
+static void
+window_tracker_ewmh_class_init (WindowTrackerEwmhClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (WindowTrackerEwmhPrivate));
+
+	object_class->dispose = window_tracker_ewmh_dispose;
+	object_class->finalize = window_tracker_ewmh_finalize;
+
+	WindowTrackerClass * tracker_class = WINDOW_TRACKER_CLASS(klass);
+	tracker_class->get_active_window = get_active_window;
+	tracker_class->get_windows = get_windows;
+	tracker_class->has_window = has_window;
+	tracker_class->get_window_type = get_window_type;
+	tracker_class->get_transient = get_transient;
+	tracker_class->get_window_prop = get_window_prop;
+	tracker_class->get_desktop_file = get_desktop_file;
+
+	return;
+}
+
+/* Initialize the per-instance data */
+static void
+window_tracker_ewmh_init (WindowTrackerEwmh *self)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(self);
+
+	priv->windows = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+	return;
+}
+
+static void
+window_tracker_ewmh_dispose (GObject *object)
+{
+	window_props_remove_event_func(handle_event, object);
+
+	G_OBJECT_CLASS (window_tracker_ewmh_parent_class)->dispose (object);
+	return;
+}
+
+static void
+window_tracker_ewmh_finalize (GObject *object)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(object);
+
+	g_hash_table_destroy(priv->windows);
+
+	G_OBJECT_CLASS (window_tracker_ewmh_parent_class)->finalize (object);
+	return;
+}
+
+static EwmhWait *
+ewmh_wait_new (WindowTrackerEwmh * tracker, guint xid, guint serial)
+{
+	EwmhWait * wait = g_new0(EwmhWait, 1);
+
+	wait->tracker = g_object_ref(tracker);
+	wait->xid = xid;
+	wait->serial = serial;
+
+	return wait;
+}
+
+static void
+ewmh_wait_free (EwmhWait * wait)
+{
+	g_object_unref(wait->tracker);
+	g_free(wait);
+
+	return;
+}
+
+/* Start reading a property, the reply goes to @func */
+static void
+fetch_property (WindowTrackerEwmh * tracker, guint xid, guint serial, xcb_atom_t property, xcb_atom_t type, guint32 length, WindowPropsReplyFunc func)
+{
+	xcb_connection_t * connection = window_props_connection();
+
+	if (connection == NULL) {
+		return;
+	}
+
+	xcb_get_property_cookie_t cookie = xcb_get_property(connection, FALSE, xid, property, type, 0, length);
+	window_props_await(cookie.sequence, func, ewmh_wait_new(tracker, xid, serial));
+
+	return;
+}
+
+/* The focus went to a window we know about and have announced, or
+   to nothing at all */
+static void
+set_active_window (WindowTrackerEwmh * tracker, guint xid)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+	guint oldxid = priv->active;
+
+	if (oldxid == xid) {
+		return;
+	}
+
+	priv->active = xid;
+	g_signal_emit_by_name(tracker, WINDOW_TRACKER_SIGNAL_ACTIVE_WINDOW_CHANGED, oldxid, xid);
+
+	return;
+}
+
+/* All the replies about a new window are in, tell everyone */
+static void
+window_settled (WindowTrackerEwmh * tracker, guint xid, EwmhWindow * window)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+
+	if (window->pending > 0 || window->announced) {
+		return;
+	}
+
+	window->announced = TRUE;
+	g_signal_emit_by_name(tracker, WINDOW_TRACKER_SIGNAL_WINDOW_OPENED, xid);
+
+	/* It got focused while we were reading about it */
+	if (priv->wanted_active == xid) {
+		set_active_window(tracker, xid);
+	}
+
+	return;
+}
+
+/* Start watching a window that showed up in the client list */
+static void
+window_added (WindowTrackerEwmh * tracker, guint xid)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+	xcb_connection_t * connection = window_props_connection();
+
+	if (connection == NULL) {
+		return;
+	}
+
+	EwmhWindow * window = g_new0(EwmhWindow, 1);
+	window->serial = ++priv->last_serial;
+	window->type = WINDOW_TRACKER_WINDOW_NORMAL;
+	g_hash_table_insert(priv->windows, GUINT_TO_POINTER(xid), window);
+
+	/* Watch before reading so that we can't miss a change in between */
+	const uint32_t event_mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+	xcb_change_window_attributes(connection, xid, XCB_CW_EVENT_MASK, &event_mask);
+
+	window->pending = PENDING_TYPE | PENDING_TRANSIENT;
+	fetch_window_type(tracker, xid, window);
+	fetch_transient(tracker, xid, window);
+
+	return;
+}
+
+/* A window left the client list */
+static void
+window_removed (WindowTrackerEwmh * tracker, guint xid)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+	EwmhWindow * window = g_hash_table_lookup(priv->windows, GUINT_TO_POINTER(xid));
+
+	if (window == NULL) {
+		return;
+	}
+
+	gboolean announced = window->announced;
+	g_hash_table_remove(priv->windows, GUINT_TO_POINTER(xid));
+
+	if (priv->wanted_active == xid) {
+		priv->wanted_active = 0;
+	}
+
+	if (priv->active == xid) {
+		priv->active = 0;
+	}
+
+	/* Nobody heard about it, so nobody has to hear it's gone */
+	if (announced) {
+		g_signal_emit_by_name(tracker, WINDOW_TRACKER_SIGNAL_WINDOW_CLOSED, xid);
+	}
+
+	return;
+}
+
+static void
+client_list_reply (void * reply, xcb_generic_error_t * error, gpointer user_data)
+{
+	EwmhWait * wait = (EwmhWait *)user_data;
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(wait->tracker);
+	xcb_get_property_reply_t * prop = reply;
+
+	if (prop == NULL) {
+		if (error == NULL) {
+			g_warning("Lost the X connection, windows won't be tracked anymore");
+		}
+		ewmh_wait_free(wait);
+		return;
+	}
+
+	GHashTable * listed = g_hash_table_new(g_direct_hash, g_direct_equal);
+	GArray * added = g_array_new(FALSE, FALSE, sizeof(guint));
+	GArray * removed = g_array_new(FALSE, FALSE, sizeof(guint));
+	GHashTableIter iter;
+	gpointer key;
+	guint i;
+
+	if (prop->type == XCB_ATOM_WINDOW && prop->format == 32) {
+		const xcb_window_t * clients = xcb_get_property_value(prop);
+		guint count = xcb_get_property_value_length(prop) / sizeof(xcb_window_t);
+
+		for (i = 0; i < count; i++) {
+			guint xid = clients[i];
+
+			if (xid == 0 || g_hash_table_contains(listed, GUINT_TO_POINTER(xid))) {
+				continue;
+			}
+
+			g_hash_table_add(listed, GUINT_TO_POINTER(xid));
+
+			if (!g_hash_table_contains(priv->windows, GUINT_TO_POINTER(xid))) {
+				g_array_append_val(added, xid);
+			}
+		}
+	}
+
+	g_hash_table_iter_init(&iter, priv->windows);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		if (!g_hash_table_contains(listed, key)) {
+			guint xid = GPOINTER_TO_UINT(key);
+			g_array_append_val(removed, xid);
+		}
+	}
+
+	for (i = 0; i < removed->len; i++) {
+		window_removed(wait->tracker, g_array_index(removed, guint, i));
+	}
+
+	for (i = 0; i < added->len; i++) {
+		window_added(wait->tracker, g_array_index(added, guint, i));
+	}
+
+	g_array_free(removed, TRUE);
+	g_array_free(added, TRUE);
+	g_hash_table_destroy(listed);
+	ewmh_wait_free(wait);
+
+	return;
+}
+
+static void
+active_window_reply (void * reply, xcb_generic_error_t * error, gpointer user_data)
+{
+	EwmhWait * wait = (EwmhWait *)user_data;
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(wait->tracker);
+	xcb_get_property_reply_t * prop = reply;
+	guint xid = 0;
+
+	if (prop == NULL) {
+		ewmh_wait_free(wait);
+		return;
+	}
+
+	if (prop->type == XCB_ATOM_WINDOW && prop->format == 32 && xcb_get_property_value_length(prop) >= sizeof(xcb_window_t)) {
+		xid = *(xcb_window_t *)xcb_get_property_value(prop);
+	}
+
+	priv->wanted_active = xid;
+
+	/* Windows we're still reading about get focused once
+	   they're announced */
+	EwmhWindow * window = g_hash_table_lookup(priv->windows, GUINT_TO_POINTER(xid));
+	if (window == NULL || window->announced) {
+		set_active_window(wait->tracker, xid);
+	}
+
+	ewmh_wait_free(wait);
+
+	return;
+}
+
+/* Turn the list of types into one of ours, the first that
+   we know about wins */
+static WindowTrackerWindowType
+window_type_from_atoms (WindowTrackerEwmhPrivate * priv, const xcb_atom_t * types, guint count)
+{
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		if (types[i] == priv->atoms[ATOM_NET_WM_WINDOW_TYPE_NORMAL]) {
+			return WINDOW_TRACKER_WINDOW_NORMAL;
+		} else if (types[i] == priv->atoms[ATOM_NET_WM_WINDOW_TYPE_DESKTOP]) {
+			return WINDOW_TRACKER_WINDOW_DESKTOP;
+		} else if (types[i] == priv->atoms[ATOM_NET_WM_WINDOW_TYPE_DOCK]) {
+			return WINDOW_TRACKER_WINDOW_DOCK;
+		} else if (types[i] == priv->atoms[ATOM_NET_WM_WINDOW_TYPE_DIALOG]) {
+			return WINDOW_TRACKER_WINDOW_DIALOG;
+		}
+	}
+
+	return WINDOW_TRACKER_WINDOW_OTHER;
+}
+
+static void
+window_type_reply (void * reply, xcb_generic_error_t * error, gpointer user_data)
+{
+	EwmhWait * wait = (EwmhWait *)user_data;
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(wait->tracker);
+	xcb_get_property_reply_t * prop = reply;
+	EwmhWindow * window = g_hash_table_lookup(priv->windows, GUINT_TO_POINTER(wait->xid));
+
+	/* Gone, or it's about a window that had the XID before */
+	if (window == NULL || window->serial != wait->serial || (prop == NULL && error == NULL)) {
+		ewmh_wait_free(wait);
+		return;
+	}
+
+	window->typed = FALSE;
+	window->type = WINDOW_TRACKER_WINDOW_NORMAL;
+
+	if (prop != NULL && prop->type == XCB_ATOM_ATOM && prop->format == 32) {
+		window->typed = TRUE;
+		window->type = window_type_from_atoms(priv,
+		                                      xcb_get_property_value(prop),
+		                                      xcb_get_property_value_length(prop) / sizeof(xcb_atom_t));
+	}
+
+	if (window->pending & PENDING_TYPE) {
+		window->pending &= ~PENDING_TYPE;
+		window_settled(wait->tracker, wait->xid, window);
+	}
+
+	ewmh_wait_free(wait);
+
+	return;
+}
+
+static void
+transient_reply (void * reply, xcb_generic_error_t * error, gpointer user_data)
+{
+	EwmhWait * wait = (EwmhWait *)user_data;
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(wait->tracker);
+	xcb_get_property_reply_t * prop = reply;
+	EwmhWindow * window = g_hash_table_lookup(priv->windows, GUINT_TO_POINTER(wait->xid));
+
+	/* Gone, or it's about a window that had the XID before */
+	if (window == NULL || window->serial != wait->serial || (prop == NULL && error == NULL)) {
+		ewmh_wait_free(wait);
+		return;
+	}
+
+	window->transient = 0;
+
+	if (prop != NULL && prop->type == XCB_ATOM_WINDOW && prop->format == 32 && xcb_get_property_value_length(prop) >= sizeof(xcb_window_t)) {
+		window->transient = *(xcb_window_t *)xcb_get_property_value(prop);
+	}
+
+	/* Some windows are transient for themselves, that'd
+	   have us going around in circles */
+	if (window->transient == wait->xid) {
+		window->transient = 0;
+	}
+
+	if (window->pending & PENDING_TRANSIENT) {
+		window->pending &= ~PENDING_TRANSIENT;
+		window_settled(wait->tracker, wait->xid, window);
+	}
+
+	ewmh_wait_free(wait);
+
+	return;
+}
+
+static void
+fetch_client_list (WindowTrackerEwmh * tracker)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+	fetch_property(tracker, priv->root, 0, priv->atoms[ATOM_NET_CLIENT_LIST], XCB_ATOM_WINDOW, CLIENT_LIST_LENGTH, client_list_reply);
+}
+
+static void
+fetch_active_window (WindowTrackerEwmh * tracker)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+	fetch_property(tracker, priv->root, 0, priv->atoms[ATOM_NET_ACTIVE_WINDOW], XCB_ATOM_WINDOW, 1, active_window_reply);
+}
+
+static void
+fetch_window_type (WindowTrackerEwmh * tracker, guint xid, EwmhWindow * window)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+	fetch_property(tracker, xid, window->serial, priv->atoms[ATOM_NET_WM_WINDOW_TYPE], XCB_ATOM_ATOM, WINDOW_TYPE_LENGTH, window_type_reply);
+}
+
+static void
+fetch_transient (WindowTrackerEwmh * tracker, guint xid, EwmhWindow * window)
+{
+	fetch_property(tracker, xid, window->serial, XCB_ATOM_WM_TRANSIENT_FOR, XCB_ATOM_WINDOW, 1, transient_reply);
+}
+
+/* Look at the property changes on the root window and the
+   windows we're watching */
+static void
+handle_event (xcb_generic_event_t * event, gpointer user_data)
+{
+	WindowTrackerEwmh * tracker = WINDOW_TRACKER_EWMH(user_data);
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+
+	if ((event->response_type & ~0x80) != XCB_PROPERTY_NOTIFY) {
+		return;
+	}
+
+	xcb_property_notify_event_t * notify = (xcb_property_notify_event_t *)event;
+
+	if (notify->window == priv->root) {
+		if (notify->atom == priv->atoms[ATOM_NET_CLIENT_LIST]) {
+			fetch_client_list(tracker);
+		} else if (notify->atom == priv->atoms[ATOM_NET_ACTIVE_WINDOW]) {
+			fetch_active_window(tracker);
+		}
+		return;
+	}
+
+	EwmhWindow * window = g_hash_table_lookup(priv->windows, GUINT_TO_POINTER(notify->window));
+	if (window == NULL) {
+		return;
+	}
+
+	/* Changes after the window was announced just update what we
+	   know, they don't hold anything up */
+	if (notify->atom == priv->atoms[ATOM_NET_WM_WINDOW_TYPE]) {
+		fetch_window_type(tracker, notify->window, window);
+	} else if (notify->atom == XCB_ATOM_WM_TRANSIENT_FOR) {
+		fetch_transient(tracker, notify->window, window);
+	}
+
+	return;
+}
+
+static guint
+get_active_window (WindowTracker * tracker)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+	return priv->active;
+}
+
+static GArray *
+get_windows (WindowTracker * tracker)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+	GArray * xids = g_array_new(FALSE, FALSE, sizeof(guint));
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_hash_table_iter_init(&iter, priv->windows);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		if (((EwmhWindow *)value)->announced) {
+			guint xid = GPOINTER_TO_UINT(key);
+			g_array_append_val(xids, xid);
+		}
+	}
+
+	return xids;
+}
+
+static EwmhWindow *
+lookup_window (WindowTracker * tracker, guint xid)
+{
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+	EwmhWindow * window = g_hash_table_lookup(priv->windows, GUINT_TO_POINTER(xid));
+
+	if (window == NULL || !window->announced) {
+		return NULL;
+	}
+
+	return window;
+}
+
+static gboolean
+has_window (WindowTracker * tracker, guint xid)
+{
+	return lookup_window(tracker, xid) != NULL;
+}
+
+static WindowTrackerWindowType
+get_window_type (WindowTracker * tracker, guint xid)
+{
+	EwmhWindow * window = lookup_window(tracker, xid);
+
+	if (window == NULL) {
+		return WINDOW_TRACKER_WINDOW_OTHER;
+	}
+
+	/* Untyped transient windows are dialogs, says the spec */
+	if (!window->typed && window->transient != 0) {
+		return WINDOW_TRACKER_WINDOW_DIALOG;
+	}
+
+	return window->type;
+}
+
+static guint
+get_transient (WindowTracker * tracker, guint xid)
+{
+	EwmhWindow * window = lookup_window(tracker, xid);
+	return window != NULL ? window->transient : 0;
+}
+
+/* Not something we keep track of, so read it through GDK's
+   connection.  Waiting on a reply on the shared connection would
+   pull in the replies others are waiting on behind the main
+   loop's back. */
+static gchar *
+get_window_prop (WindowTracker * tracker, guint xid, const gchar * name)
+{
+	GdkDisplay * display = gdk_display_get_default();
+	guchar * data = NULL;
+	gchar * value = NULL;
+	Atom type;
+	gint format;
+	gulong nitems;
+	gulong bytes_after;
+
+	if (display == NULL || !GDK_IS_X11_DISPLAY(display)) {
+		return NULL;
+	}
+
+	gdk_x11_display_error_trap_push(display);
+	XGetWindowProperty(GDK_DISPLAY_XDISPLAY(display), xid,
+	                   gdk_x11_get_xatom_by_name_for_display(display, name),
+	                   0, G_MAXLONG, False,
+	                   gdk_x11_get_xatom_by_name_for_display(display, "UTF8_STRING"),
+	                   &type, &format, &nitems, &bytes_after, &data);
+	if (gdk_x11_display_error_trap_pop(display) != 0) {
+		return NULL;
+	}
+
+	if (data != NULL && format == 8 && nitems > 0) {
+		value = g_strndup((const gchar *)data, nitems);
+	}
+
+	if (data != NULL) {
+		XFree(data);
+	}
+
+	return value;
+}
+
+static gchar *
+get_desktop_file (WindowTracker * tracker, guint xid)
+{
+	return get_window_prop(tracker, xid, DESKTOP_FILE_PROP);
+}
+
+/**************************
+  API
+ **************************/
+
+/* Follows the windows through the properties the window manager sets
+   on the root window, NULL if there's no X connection to do that on */
+WindowTrackerEwmh *
+window_tracker_ewmh_new (void)
+{
+	xcb_connection_t * connection = window_props_connection();
+	GdkDisplay * display = gdk_display_get_default();
+
+	if (connection == NULL) {
+		return NULL;
+	}
+
+	WindowTrackerEwmh * tracker = g_object_new(WINDOW_TRACKER_EWMH_TYPE, NULL);
+	WindowTrackerEwmhPrivate * priv = WINDOW_TRACKER_EWMH_GET_PRIVATE(tracker);
+
+	priv->root = gdk_x11_get_default_root_xwindow();
+
+	/* Atoms are the same on every connection, GDK has most of
+	   these already and blocking on the shared connection could
+	   leave replies sitting in its buffer */
+	guint atom;
+	for (atom = 0; atom < N_ATOMS; atom++) {
+		priv->atoms[atom] = gdk_x11_get_xatom_by_name_for_display(display, atom_names[atom]);
+	}
+
+	window_props_add_event_func(handle_event, tracker);
+
+	/* Event masks are per connection, so this doesn't change what
+	   GDK or the window manager get from the root window */
+	const uint32_t event_mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+	xcb_change_window_attributes(connection, priv->root, XCB_CW_EVENT_MASK, &event_mask);
+
+	fetch_client_list(tracker);
+	fetch_active_window(tracker);
+
+	return tracker;
+}
@@ -0,0 +1,49 @@
+/*
+Window tracking straight from the EWMH properties on the root window.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __WINDOW_TRACKER_EWMH_H__
+#define __WINDOW_TRACKER_EWMH_H__
+
+#include "window-tracker.h"
+
+G_BEGIN_DECLS
+
+#define WINDOW_TRACKER_EWMH_TYPE            (window_tracker_ewmh_get_type ())
+#define WINDOW_TRACKER_EWMH(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), WINDOW_TRACKER_EWMH_TYPE, WindowTrackerEwmh))
+#define WINDOW_TRACKER_EWMH_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), WINDOW_TRACKER_EWMH_TYPE, WindowTrackerEwmhClass))
+#define IS_WINDOW_TRACKER_EWMH(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), WINDOW_TRACKER_EWMH_TYPE))
+#define IS_WINDOW_TRACKER_EWMH_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), WINDOW_TRACKER_EWMH_TYPE))
+#define WINDOW_TRACKER_EWMH_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), WINDOW_TRACKER_EWMH_TYPE, WindowTrackerEwmhClass))
+
+typedef struct _WindowTrackerEwmh      WindowTrackerEwmh;
+typedef struct _WindowTrackerEwmhClass WindowTrackerEwmhClass;
+
+struct _WindowTrackerEwmhClass {
+	WindowTrackerClass parent_class;
+};
+
+struct _WindowTrackerEwmh {
+	WindowTracker parent;
+};
+
+GType window_tracker_ewmh_get_type (void);
+WindowTrackerEwmh * window_tracker_ewmh_new (void);
+
+G_END_DECLS
+
+#endif
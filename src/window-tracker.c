@@ -0,0 +1,200 @@
+/*
+Following the windows on the screen and which one has the focus.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "window-tracker.h"
+#include "indicator-appmenu-marshal.h"
+
+/* Signals */
+
+enum {
+	WINDOW_OPENED,
+	WINDOW_CLOSED,
+	ACTIVE_WINDOW_CHANGED,
+	LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+/* Prototypes */
+
+static void window_tracker_class_init (WindowTrackerClass *klass);
+static void window_tracker_init       (WindowTracker *self);
+
+G_DEFINE_ABSTRACT_TYPE (WindowTracker, window_tracker, G_TYPE_OBJECT);
+
+static void
+window_tracker_class_init (WindowTrackerClass *klass)
+{
+	/* Signals */
+	signals[WINDOW_OPENED] =  g_signal_new(WINDOW_TRACKER_SIGNAL_WINDOW_OPENED,
+	                                      G_TYPE_FROM_CLASS(klass),
+	                                      G_SIGNAL_RUN_LAST,
+	                                      G_STRUCT_OFFSET (WindowTrackerClass, window_opened),
+	                                      NULL, NULL,
+	                                      g_cclosure_marshal_VOID__UINT,
+	                                      G_TYPE_NONE, 1, G_TYPE_UINT);
+	signals[WINDOW_CLOSED] =  g_signal_new(WINDOW_TRACKER_SIGNAL_WINDOW_CLOSED,
+	                                      G_TYPE_FROM_CLASS(klass),
+	                                      G_SIGNAL_RUN_LAST,
+	                                      G_STRUCT_OFFSET (WindowTrackerClass, window_closed),
+	                                      NULL, NULL,
+	                                      g_cclosure_marshal_VOID__UINT,
+	                                      G_TYPE_NONE, 1, G_TYPE_UINT);
+	signals[ACTIVE_WINDOW_CHANGED] = g_signal_new(WINDOW_TRACKER_SIGNAL_ACTIVE_WINDOW_CHANGED,
+	                                      G_TYPE_FROM_CLASS(klass),
+	                                      G_SIGNAL_RUN_LAST,
+	                                      G_STRUCT_OFFSET (WindowTrackerClass, active_window_changed),
+	                                      NULL, NULL,
+	                                      _indicator_appmenu_marshal_VOID__UINT_UINT,
+	                                      G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_UINT);
+
+	return;
+}
+
+static void
+window_tracker_init (WindowTracker *self)
+{
+
+	return;
+}
+
+/**************************
+  API
+ **************************/
+guint
+window_tracker_get_active_window (WindowTracker * tracker)
+{
+	g_return_val_if_fail(IS_WINDOW_TRACKER(tracker), 0);
+
+	WindowTrackerClass * class = WINDOW_TRACKER_GET_CLASS(tracker);
+
+	if (class->get_active_window != NULL) {
+		return class->get_active_window(tracker);
+	} else {
+		return 0;
+	}
+}
+
+/* An array of the XIDs of all the windows, free it with g_array_unref() */
+GArray *
+window_tracker_get_windows (WindowTracker * tracker)
+{
+	g_return_val_if_fail(IS_WINDOW_TRACKER(tracker), NULL);
+
+	WindowTrackerClass * class = WINDOW_TRACKER_GET_CLASS(tracker);
+
+	if (class->get_windows != NULL) {
+		return class->get_windows(tracker);
+	} else {
+		return g_array_new(FALSE, FALSE, sizeof(guint));
+	}
+}
+
+/* Whether @xid is a window that's open right now */
+gboolean
+window_tracker_has_window (WindowTracker * tracker, guint xid)
+{
+	g_return_val_if_fail(IS_WINDOW_TRACKER(tracker), FALSE);
+
+	WindowTrackerClass * class = WINDOW_TRACKER_GET_CLASS(tracker);
+
+	if (xid != 0 && class->has_window != NULL) {
+		return class->has_window(tracker, xid);
+	} else {
+		return FALSE;
+	}
+}
+
+WindowTrackerWindowType
+window_tracker_get_window_type (WindowTracker * tracker, guint xid)
+{
+	g_return_val_if_fail(IS_WINDOW_TRACKER(tracker), WINDOW_TRACKER_WINDOW_OTHER);
+
+	WindowTrackerClass * class = WINDOW_TRACKER_GET_CLASS(tracker);
+
+	if (class->get_window_type != NULL) {
+		return class->get_window_type(tracker, xid);
+	} else {
+		return WINDOW_TRACKER_WINDOW_NORMAL;
+	}
+}
+
+/* The window @xid is transient for, or zero */
+guint
+window_tracker_get_transient (WindowTracker * tracker, guint xid)
+{
+	g_return_val_if_fail(IS_WINDOW_TRACKER(tracker), 0);
+
+	WindowTrackerClass * class = WINDOW_TRACKER_GET_CLASS(tracker);
+
+	if (class->get_transient != NULL) {
+		return class->get_transient(tracker, xid);
+	} else {
+		return 0;
+	}
+}
+
+/* A UTF-8 property on the window, NULL if it's not set */
+gchar *
+window_tracker_get_window_prop (WindowTracker * tracker, guint xid, const gchar * name)
+{
+	g_return_val_if_fail(IS_WINDOW_TRACKER(tracker), NULL);
+	g_return_val_if_fail(name != NULL, NULL);
+
+	WindowTrackerClass * class = WINDOW_TRACKER_GET_CLASS(tracker);
+
+	if (class->get_window_prop != NULL) {
+		return class->get_window_prop(tracker, xid, name);
+	} else {
+		return NULL;
+	}
+}
+
+/* Path to the desktop file of the application, NULL if it has none */
+gchar *
+window_tracker_get_desktop_file (WindowTracker * tracker, guint xid)
+{
+	g_return_val_if_fail(IS_WINDOW_TRACKER(tracker), NULL);
+
+	WindowTrackerClass * class = WINDOW_TRACKER_GET_CLASS(tracker);
+
+	if (class->get_desktop_file != NULL) {
+		return class->get_desktop_file(tracker, xid);
+	} else {
+		return NULL;
+	}
+}
+
+/* Whether the application is fine with having menu stubs */
+gboolean
+window_tracker_get_show_menu_stubs (WindowTracker * tracker, guint xid)
+{
+	g_return_val_if_fail(IS_WINDOW_TRACKER(tracker), TRUE);
+
+	WindowTrackerClass * class = WINDOW_TRACKER_GET_CLASS(tracker);
+
+	if (class->get_show_menu_stubs != NULL) {
+		return class->get_show_menu_stubs(tracker, xid);
+	} else {
+		return TRUE;
+	}
+}
@@ -0,0 +1,93 @@
+/*
+Following the windows on the screen and which one has the focus.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __WINDOW_TRACKER_H__
+#define __WINDOW_TRACKER_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define WINDOW_TRACKER_TYPE             (window_tracker_get_type ())
+#define WINDOW_TRACKER(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), WINDOW_TRACKER_TYPE, WindowTracker))
+#define WINDOW_TRACKER_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), WINDOW_TRACKER_TYPE, WindowTrackerClass))
+#define IS_WINDOW_TRACKER(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), WINDOW_TRACKER_TYPE))
+#define IS_WINDOW_TRACKER_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), WINDOW_TRACKER_TYPE))
+#define WINDOW_TRACKER_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), WINDOW_TRACKER_TYPE, WindowTrackerClass))
+
+#define WINDOW_TRACKER_SIGNAL_WINDOW_OPENED          "window-opened"
+#define WINDOW_TRACKER_SIGNAL_WINDOW_CLOSED          "window-closed"
+#define WINDOW_TRACKER_SIGNAL_ACTIVE_WINDOW_CHANGED  "active-window-changed"
+
+typedef enum _WindowTrackerWindowType WindowTrackerWindowType;
+enum _WindowTrackerWindowType {
+	WINDOW_TRACKER_WINDOW_NORMAL,
+	WINDOW_TRACKER_WINDOW_DESKTOP,
+	WINDOW_TRACKER_WINDOW_DOCK,
+	WINDOW_TRACKER_WINDOW_DIALOG,
+	WINDOW_TRACKER_WINDOW_OTHER
+};
+
+typedef struct _WindowTracker      WindowTracker;
+typedef struct _WindowTrackerClass WindowTrackerClass;
+
+/* Windows are their XIDs, zero being no window.  Everything here
+   is answered from what the tracker already knows, so it's cheap
+   to ask again. */
+struct _WindowTrackerClass {
+	GObjectClass parent_class;
+
+	/* Virtual Funcs */
+	guint             (*get_active_window)    (WindowTracker * tracker);
+	GArray *          (*get_windows)          (WindowTracker * tracker);
+	gboolean          (*has_window)           (WindowTracker * tracker, guint xid);
+
+	WindowTrackerWindowType (*get_window_type)      (WindowTracker * tracker, guint xid);
+	guint             (*get_transient)        (WindowTracker * tracker, guint xid);
+	gchar *           (*get_window_prop)      (WindowTracker * tracker, guint xid, const gchar * name);
+
+	/* About the application the window belongs to */
+	gchar *           (*get_desktop_file)     (WindowTracker * tracker, guint xid);
+	gboolean          (*get_show_menu_stubs)  (WindowTracker * tracker, guint xid);
+
+	/* Signals */
+	void (*window_opened)          (WindowTracker * tracker, guint xid, gpointer user_data);
+	void (*window_closed)          (WindowTracker * tracker, guint xid, gpointer user_data);
+	void (*active_window_changed)  (WindowTracker * tracker, guint old_xid, guint new_xid, gpointer user_data);
+};
+
+struct _WindowTracker {
+	GObject parent;
+};
+
+GType window_tracker_get_type (void);
+
+guint window_tracker_get_active_window (WindowTracker * tracker);
+GArray * window_tracker_get_windows (WindowTracker * tracker);
+gboolean window_tracker_has_window (WindowTracker * tracker, guint xid);
+
+WindowTrackerWindowType window_tracker_get_window_type (WindowTracker * tracker, guint xid);
+guint window_tracker_get_transient (WindowTracker * tracker, guint xid);
+gchar * window_tracker_get_window_prop (WindowTracker * tracker, guint xid, const gchar * name);
+
+gchar * window_tracker_get_desktop_file (WindowTracker * tracker, guint xid);
+gboolean window_tracker_get_show_menu_stubs (WindowTracker * tracker, guint xid);
+
+G_END_DECLS
+
+#endif
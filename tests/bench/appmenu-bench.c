@@ -0,0 +1,542 @@
+/*
+Headless benchmark of the registrar.  Loads the indicator like the
+panel would, puts up windows with menus, and drives focus through the
+mock BAMF daemon to see how long things take.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <gio/gio.h>
+#include <libdbusmenu-glib/menuitem.h>
+#include <libdbusmenu-glib/server.h>
+#include <libayatana-indicator/indicator-object.h>
+
+#include "../../src/dbus-shared.h"
+
+/* The control interface of mock-bamf.py */
+#define BAMF_NAME      "org.ayatana.bamf"
+#define BENCH_OBJECT   "/org/ayatana/bamf/bench"
+#define BENCH_IFACE    "org.ayatana.bamf.Bench"
+
+/* Nothing we wait for should take anywhere near this long */
+#define WAIT_TIMEOUT   10000
+/* How long without events before we call things settled */
+#define SETTLE_QUIET   50
+
+typedef struct _BenchWindow BenchWindow;
+struct _BenchWindow {
+	GdkWindow * window;
+	guint xid;
+	gchar * path;
+	DbusmenuServer * server;
+};
+
+static gchar * indicator_file = NULL;
+static gchar * output_file = NULL;
+static gchar * sizes = NULL;
+static gint switches = 50;
+static gint menu_width = 6;
+static gint menu_length = 10;
+
+static GOptionEntry options[] = {
+	{"indicator", 'i', 0, G_OPTION_ARG_FILENAME, &indicator_file, "The indicator module to load", "FILE"},
+	{"output",    'o', 0, G_OPTION_ARG_FILENAME, &output_file,    "Where to write the JSON results, stdout otherwise", "FILE"},
+	{"sizes",     's', 0, G_OPTION_ARG_STRING,   &sizes,          "Numbers of windows to run with (10,100,1000)", "N,N,..."},
+	{"switches",  'f', 0, G_OPTION_ARG_INT,      &switches,       "Focus switches to time for each size (50)", "N"},
+	{"width",     'w', 0, G_OPTION_ARG_INT,      &menu_width,     "Entries on each window's menubar (6)", "N"},
+	{"length",    'l', 0, G_OPTION_ARG_INT,      &menu_length,    "Items under each entry (10)", "N"},
+	{NULL}
+};
+
+static GDBusConnection * bus = NULL;
+static IndicatorObject * indicator = NULL;
+
+/* Sets the flag it's given when the wait has gone on too long */
+static gboolean
+wait_timeout (gpointer user_data)
+{
+	*(gboolean *)user_data = TRUE;
+	return G_SOURCE_REMOVE;
+}
+
+/* Run the main loop until @done says so, FALSE if it never did */
+static gboolean
+wait_for (gboolean (*done) (gpointer data), gpointer data)
+{
+	gboolean timed_out = FALSE;
+	guint timer = g_timeout_add(WAIT_TIMEOUT, wait_timeout, &timed_out);
+
+	while (!done(data) && !timed_out) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	if (!timed_out) {
+		g_source_remove(timer);
+	}
+
+	return !timed_out;
+}
+
+/* Run the main loop until nothing has happened for a little while */
+static void
+settle (void)
+{
+	gint64 quiet = g_get_monotonic_time() + SETTLE_QUIET * 1000;
+
+	while (g_get_monotonic_time() < quiet) {
+		if (g_main_context_iteration(NULL, FALSE)) {
+			quiet = g_get_monotonic_time() + SETTLE_QUIET * 1000;
+		} else {
+			g_usleep(1000);
+		}
+	}
+
+	return;
+}
+
+static gboolean
+counter_reached (gpointer data)
+{
+	guint * counts = (guint *)data;
+	return counts[0] >= counts[1];
+}
+
+static gboolean
+name_has_owner (const gchar * name)
+{
+	GVariant * ret = g_dbus_connection_call_sync(bus, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+	                                             "org.freedesktop.DBus", "NameHasOwner",
+	                                             g_variant_new("(s)", name),
+	                                             G_VARIANT_TYPE("(b)"), G_DBUS_CALL_FLAGS_NONE,
+	                                             -1, NULL, NULL);
+	gboolean owned = FALSE;
+
+	if (ret != NULL) {
+		g_variant_get(ret, "(b)", &owned);
+		g_variant_unref(ret);
+	}
+
+	return owned;
+}
+
+/* Poll for @name to show up on the bus, there might not be any
+   events to wake the main loop while we wait */
+static gboolean
+wait_for_name (const gchar * name)
+{
+	gint64 deadline = g_get_monotonic_time() + WAIT_TIMEOUT * 1000;
+
+	while (!name_has_owner(name)) {
+		if (g_get_monotonic_time() > deadline) {
+			return FALSE;
+		}
+
+		while (g_main_context_iteration(NULL, FALSE));
+		g_usleep(10000);
+	}
+
+	return TRUE;
+}
+
+/* Whether the entries on the panel are the ones of @data's window */
+static gboolean
+entries_show_window (gpointer data)
+{
+	guint xid = GPOINTER_TO_UINT(data);
+	GList * entries = indicator_object_get_entries(indicator);
+	gboolean shown = entries != NULL;
+	GList * lentry;
+
+	for (lentry = entries; lentry != NULL; lentry = g_list_next(lentry)) {
+		IndicatorObjectEntry * entry = (IndicatorObjectEntry *)lentry->data;
+		if (entry->parent_window != xid) {
+			shown = FALSE;
+			break;
+		}
+	}
+
+	g_list_free(entries);
+	return shown;
+}
+
+/* Call the mock BAMF daemon, it's out of process so this can block */
+static gboolean
+bench_call (const gchar * method, GVariant * params)
+{
+	GError * error = NULL;
+	GVariant * ret = g_dbus_connection_call_sync(bus, BAMF_NAME, BENCH_OBJECT, BENCH_IFACE,
+	                                             method, params, NULL,
+	                                             G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+
+	if (ret == NULL) {
+		g_warning("Unable to call '%s' on the mock BAMF: %s", method, error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	g_variant_unref(ret);
+	return TRUE;
+}
+
+static GVariant *
+window_xids (GArray * windows)
+{
+	GVariantBuilder builder;
+	guint i;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("au"));
+	for (i = 0; i < windows->len; i++) {
+		g_variant_builder_add(&builder, "u", g_array_index(windows, BenchWindow, i).xid);
+	}
+
+	return g_variant_new("(@au)", g_variant_builder_end(&builder));
+}
+
+/* What the kernel says we're using right now */
+static guint
+rss_kb (void)
+{
+	gchar * status = NULL;
+	guint rss = 0;
+
+	if (g_file_get_contents("/proc/self/status", &status, NULL, NULL)) {
+		gchar * line = strstr(status, "VmRSS:");
+		if (line != NULL) {
+			rss = (guint)strtoul(line + strlen("VmRSS:"), NULL, 10);
+		}
+		g_free(status);
+	}
+
+	return rss;
+}
+
+/* A menubar like an application would have */
+static DbusmenuMenuitem *
+build_menu (guint xid)
+{
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+	gint i, j;
+
+	for (i = 0; i < menu_width; i++) {
+		DbusmenuMenuitem * entry = dbusmenu_menuitem_new();
+		gchar * label = g_strdup_printf("_Menu %d", i);
+		dbusmenu_menuitem_property_set(entry, DBUSMENU_MENUITEM_PROP_LABEL, label);
+		dbusmenu_menuitem_property_set(entry, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+		g_free(label);
+
+		for (j = 0; j < menu_length; j++) {
+			DbusmenuMenuitem * item = dbusmenu_menuitem_new();
+			label = g_strdup_printf("Item %d of %X", j, xid);
+			dbusmenu_menuitem_property_set(item, DBUSMENU_MENUITEM_PROP_LABEL, label);
+			g_free(label);
+
+			dbusmenu_menuitem_child_append(entry, item);
+			g_object_unref(item);
+		}
+
+		dbusmenu_menuitem_child_append(root, entry);
+		g_object_unref(entry);
+	}
+
+	return root;
+}
+
+static GArray *
+windows_new (guint count)
+{
+	GArray * windows = g_array_sized_new(FALSE, TRUE, sizeof(BenchWindow), count);
+	GdkWindowAttr attributes = {0};
+	guint i;
+
+	attributes.width = 1;
+	attributes.height = 1;
+	attributes.wclass = GDK_INPUT_OUTPUT;
+	attributes.window_type = GDK_WINDOW_TOPLEVEL;
+
+	for (i = 0; i < count; i++) {
+		BenchWindow window;
+
+		window.window = gdk_window_new(NULL, &attributes, 0);
+		window.xid = gdk_x11_window_get_xid(window.window);
+		window.path = g_strdup_printf("/bench/menu/%u", i);
+		window.server = dbusmenu_server_new(window.path);
+
+		DbusmenuMenuitem * root = build_menu(window.xid);
+		dbusmenu_server_set_root(window.server, root);
+		g_object_unref(root);
+
+		g_array_append_val(windows, window);
+	}
+
+	return windows;
+}
+
+static void
+windows_free (GArray * windows)
+{
+	guint i;
+
+	for (i = 0; i < windows->len; i++) {
+		BenchWindow * window = &g_array_index(windows, BenchWindow, i);
+		g_object_unref(window->server);
+		gdk_window_destroy(window->window);
+		g_free(window->path);
+	}
+
+	g_array_free(windows, TRUE);
+	return;
+}
+
+static void
+call_done (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+	guint * counts = (guint *)user_data;
+	GError * error = NULL;
+	GVariant * ret = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+
+	if (ret == NULL) {
+		g_warning("Registrar call failed: %s", error->message);
+		g_error_free(error);
+	} else {
+		g_variant_unref(ret);
+	}
+
+	counts[0]++;
+	return;
+}
+
+/* Call @method on the registrar for every window and wait for all the
+   replies.  The registrar is in this process, so these can't block. */
+static gboolean
+registrar_call_all (GArray * windows, const gchar * method)
+{
+	guint counts[2] = {0, windows->len};
+	guint i;
+
+	for (i = 0; i < windows->len; i++) {
+		BenchWindow * window = &g_array_index(windows, BenchWindow, i);
+		GVariant * params;
+
+		if (g_strcmp0(method, "RegisterWindow") == 0) {
+			params = g_variant_new("(uo)", window->xid, window->path);
+		} else {
+			params = g_variant_new("(u)", window->xid);
+		}
+
+		g_dbus_connection_call(bus, DBUS_NAME, REG_OBJECT, REG_IFACE,
+		                       method, params, NULL,
+		                       G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+		                       call_done, counts);
+	}
+
+	return wait_for(counter_reached, counts);
+}
+
+static gint
+compare_times (gconstpointer a, gconstpointer b)
+{
+	gint64 ta = *(const gint64 *)a;
+	gint64 tb = *(const gint64 *)b;
+	return ta < tb ? -1 : (ta > tb ? 1 : 0);
+}
+
+static void
+append_latencies (GString * json, GArray * times)
+{
+	gint64 sum = 0;
+	guint i;
+
+	if (times->len == 0) {
+		g_string_append(json, "null");
+		return;
+	}
+
+	g_array_sort(times, compare_times);
+	for (i = 0; i < times->len; i++) {
+		sum += g_array_index(times, gint64, i);
+	}
+
+	g_string_append_printf(json,
+	                       "{\"count\": %u, \"min\": %" G_GINT64_FORMAT ", \"median\": %" G_GINT64_FORMAT
+	                       ", \"p95\": %" G_GINT64_FORMAT ", \"max\": %" G_GINT64_FORMAT ", \"mean\": %" G_GINT64_FORMAT "}",
+	                       times->len,
+	                       g_array_index(times, gint64, 0),
+	                       g_array_index(times, gint64, times->len / 2),
+	                       g_array_index(times, gint64, (times->len * 95) / 100),
+	                       g_array_index(times, gint64, times->len - 1),
+	                       sum / times->len);
+
+	return;
+}
+
+/* One round with @count windows, the results go on @json */
+static gboolean
+run_size (guint count, GString * json)
+{
+	GArray * windows = windows_new(count);
+	GArray * latencies = g_array_new(FALSE, FALSE, sizeof(gint64));
+	gboolean ok = TRUE;
+	guint failed = 0;
+	gint i;
+
+	bench_call("AddWindows", window_xids(windows));
+	settle();
+
+	guint rss_before = rss_kb();
+
+	gint64 start = g_get_monotonic_time();
+	ok = registrar_call_all(windows, "RegisterWindow");
+	gint64 register_time = g_get_monotonic_time() - start;
+	settle();
+
+	/* Walk around the windows so that both new and cached
+	   menus get shown */
+	guint current = 0;
+	for (i = 0; ok && i < switches; i++) {
+		guint next = (current + 1 + g_random_int_range(0, MAX(count - 1, 1))) % count;
+		guint xid = g_array_index(windows, BenchWindow, next).xid;
+
+		start = g_get_monotonic_time();
+		bench_call("Focus", g_variant_new("(u)", xid));
+		if (wait_for(entries_show_window, GUINT_TO_POINTER(xid))) {
+			gint64 latency = g_get_monotonic_time() - start;
+			g_array_append_val(latencies, latency);
+		} else {
+			failed++;
+		}
+
+		current = next;
+	}
+	settle();
+
+	guint rss_after = rss_kb();
+
+	start = g_get_monotonic_time();
+	registrar_call_all(windows, "UnregisterWindow");
+	gint64 unregister_time = g_get_monotonic_time() - start;
+
+	bench_call("RemoveWindows", window_xids(windows));
+	settle();
+
+	g_string_append_printf(json,
+	                       "    {\"windows\": %u, \"register_usec\": %" G_GINT64_FORMAT
+	                       ", \"registrations_per_sec\": %.1f, \"unregister_usec\": %" G_GINT64_FORMAT
+	                       ", \"focus_switches_failed\": %u, \"focus_latency_usec\": ",
+	                       count, register_time,
+	                       register_time > 0 ? (count * (gdouble)G_USEC_PER_SEC) / register_time : 0.0,
+	                       unregister_time, failed);
+	append_latencies(json, latencies);
+	g_string_append_printf(json,
+	                       ", \"rss_kb_before\": %u, \"rss_kb_after\": %u, \"rss_kb_per_window\": %.1f}",
+	                       rss_before, rss_after,
+	                       rss_after > rss_before ? (gdouble)(rss_after - rss_before) / count : 0.0);
+
+	g_array_free(latencies, TRUE);
+	windows_free(windows);
+
+	return ok;
+}
+
+int
+main (int argc, char ** argv)
+{
+	GError * error = NULL;
+	GOptionContext * context = g_option_context_new("- benchmark the application menu registrar");
+	g_option_context_add_main_entries(context, options, NULL);
+	g_option_context_add_group(context, gtk_get_option_group(TRUE));
+
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	if (indicator_file == NULL) {
+		g_printerr("The indicator module to load is needed, see --help\n");
+		return 1;
+	}
+
+	bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+	if (bus == NULL) {
+		g_printerr("Unable to get the session bus: %s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+
+	if (!wait_for_name(BAMF_NAME)) {
+		g_printerr("The mock BAMF daemon never showed up\n");
+		return 1;
+	}
+
+	indicator = indicator_object_new_from_file(indicator_file);
+	if (indicator == NULL) {
+		g_printerr("Unable to load the indicator from '%s'\n", indicator_file);
+		return 1;
+	}
+
+	if (!wait_for_name(DBUS_NAME)) {
+		g_printerr("The registrar never got its name\n");
+		return 1;
+	}
+	settle();
+
+	GString * json = g_string_new(NULL);
+	gchar ** counts = g_strsplit(sizes != NULL ? sizes : "10,100,1000", ",", -1);
+	gboolean ok = TRUE;
+	gboolean first = TRUE;
+	gint i;
+
+	g_string_append_printf(json,
+	                       "{\n  \"menu_width\": %d,\n  \"menu_length\": %d,\n  \"switches\": %d,\n  \"results\": [\n",
+	                       menu_width, menu_length, switches);
+
+	for (i = 0; counts[i] != NULL && ok; i++) {
+		guint count = (guint)g_ascii_strtoull(counts[i], NULL, 10);
+		if (count == 0) {
+			continue;
+		}
+
+		if (!first) {
+			g_string_append(json, ",\n");
+		}
+		first = FALSE;
+		ok = run_size(count, json);
+	}
+
+	g_string_append(json, "\n  ]\n}\n");
+	g_strfreev(counts);
+
+	if (output_file != NULL) {
+		if (!g_file_set_contents(output_file, json->str, json->len, &error)) {
+			g_printerr("Unable to write '%s': %s\n", output_file, error->message);
+			g_error_free(error);
+			ok = FALSE;
+		}
+	} else {
+		g_print("%s", json->str);
+	}
+
+	g_string_free(json, TRUE);
+	g_object_unref(indicator);
+	g_object_unref(bus);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,335 @@
+#!/usr/bin/env python3
+#
+# A stand-in for bamfdaemon that the benchmark can script.  It puts up
+# the parts of the org.ayatana.bamf matcher, view, window and
+# application interfaces that libbamf needs to follow windows, and a
+# control interface to open, close and focus them.  Every window gets
+# an application of its own.
+#
+# Copyright 2026 Canonical Ltd.
+#
+# This program is free software: you can redistribute it and/or modify it
+# under the terms of the GNU General Public License version 3, as published
+# by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranties of
+# MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+# PURPOSE.  See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+import sys
+
+from gi.repository import Gio, GLib
+
+BAMF_NAME = 'org.ayatana.bamf'
+MATCHER_PATH = '/org/ayatana/bamf/matcher'
+BENCH_PATH = '/org/ayatana/bamf/bench'
+
+INTERFACES = '''
+<node>
+  <interface name="org.ayatana.bamf.matcher">
+    <method name="ActiveApplication"><arg type="s" direction="out"/></method>
+    <method name="ActiveWindow"><arg type="s" direction="out"/></method>
+    <method name="ApplicationForXid"><arg type="u" direction="in"/><arg type="s" direction="out"/></method>
+    <method name="ApplicationIsRunning"><arg type="s" direction="in"/><arg type="b" direction="out"/></method>
+    <method name="ApplicationPaths"><arg type="as" direction="out"/></method>
+    <method name="PathForApplication"><arg type="s" direction="in"/><arg type="s" direction="out"/></method>
+    <method name="RegisterFavorites"><arg type="as" direction="in"/></method>
+    <method name="RunningApplications"><arg type="as" direction="out"/></method>
+    <method name="RunningApplicationsDesktopFiles"><arg type="as" direction="out"/></method>
+    <method name="TabPaths"><arg type="as" direction="out"/></method>
+    <method name="WindowPaths"><arg type="as" direction="out"/></method>
+    <method name="WindowStackForMonitor"><arg type="i" direction="in"/><arg type="as" direction="out"/></method>
+    <method name="XidsForApplication"><arg type="s" direction="in"/><arg type="au" direction="out"/></method>
+    <signal name="ActiveApplicationChanged"><arg type="s"/><arg type="s"/></signal>
+    <signal name="ActiveWindowChanged"><arg type="s"/><arg type="s"/></signal>
+    <signal name="ViewOpened"><arg type="s"/><arg type="s"/></signal>
+    <signal name="ViewClosed"><arg type="s"/><arg type="s"/></signal>
+    <signal name="StackingOrderChanged"/>
+    <signal name="RunningApplicationsChanged"><arg type="as"/><arg type="as"/></signal>
+  </interface>
+  <interface name="org.ayatana.bamf.view">
+    <method name="Children"><arg type="as" direction="out"/></method>
+    <method name="Parents"><arg type="as" direction="out"/></method>
+    <method name="IsActive"><arg type="b" direction="out"/></method>
+    <method name="IsRunning"><arg type="b" direction="out"/></method>
+    <method name="IsUrgent"><arg type="b" direction="out"/></method>
+    <method name="IsUserVisible"><arg type="b" direction="out"/></method>
+    <method name="Name"><arg type="s" direction="out"/></method>
+    <method name="Icon"><arg type="s" direction="out"/></method>
+    <method name="ViewType"><arg type="s" direction="out"/></method>
+    <property name="Name" type="s" access="read"/>
+    <property name="Icon" type="s" access="read"/>
+    <property name="Active" type="b" access="read"/>
+    <property name="Running" type="b" access="read"/>
+    <property name="Starting" type="b" access="read"/>
+    <property name="Urgent" type="b" access="read"/>
+    <property name="UserVisible" type="b" access="read"/>
+    <signal name="ActiveChanged"><arg type="b"/></signal>
+    <signal name="Closed"/>
+    <signal name="ChildAdded"><arg type="s"/></signal>
+    <signal name="ChildRemoved"><arg type="s"/></signal>
+    <signal name="ChildMoved"><arg type="s"/></signal>
+    <signal name="RunningChanged"><arg type="b"/></signal>
+    <signal name="UrgentChanged"><arg type="b"/></signal>
+    <signal name="UserVisibleChanged"><arg type="b"/></signal>
+    <signal name="NameChanged"><arg type="s"/><arg type="s"/></signal>
+  </interface>
+  <interface name="org.ayatana.bamf.window">
+    <method name="GetXid"><arg type="u" direction="out"/></method>
+    <method name="GetPid"><arg type="u" direction="out"/></method>
+    <method name="Transient"><arg type="s" direction="out"/></method>
+    <method name="WindowType"><arg type="u" direction="out"/></method>
+    <method name="Xprop"><arg type="s" direction="in"/><arg type="s" direction="out"/></method>
+    <method name="Monitor"><arg type="i" direction="out"/></method>
+    <method name="Maximized"><arg type="i" direction="out"/></method>
+    <signal name="MonitorChanged"><arg type="i"/><arg type="i"/></signal>
+    <signal name="MaximizedChanged"><arg type="i"/><arg type="i"/></signal>
+  </interface>
+  <interface name="org.ayatana.bamf.application">
+    <method name="ApplicationType"><arg type="s" direction="out"/></method>
+    <method name="DesktopFile"><arg type="s" direction="out"/></method>
+    <method name="FocusableChild"><arg type="s" direction="out"/></method>
+    <method name="ShowStubs"><arg type="b" direction="out"/></method>
+    <method name="SupportedMimeTypes"><arg type="as" direction="out"/></method>
+    <method name="Xids"><arg type="au" direction="out"/></method>
+    <signal name="WindowAdded"><arg type="s"/></signal>
+    <signal name="WindowRemoved"><arg type="s"/></signal>
+    <signal name="SupportedMimeTypesChanged"><arg type="as"/></signal>
+    <signal name="DesktopFileUpdated"><arg type="s"/></signal>
+  </interface>
+  <interface name="org.ayatana.bamf.Bench">
+    <method name="AddWindows"><arg name="xids" type="au" direction="in"/></method>
+    <method name="RemoveWindows"><arg name="xids" type="au" direction="in"/></method>
+    <method name="Focus"><arg name="xid" type="u" direction="in"/></method>
+    <method name="Quit"/>
+  </interface>
+</node>
+'''
+
+node = Gio.DBusNodeInfo.new_for_xml(INTERFACES)
+iface = {i.name: i for i in node.interfaces}
+
+
+def window_path(xid):
+    return '/org/ayatana/bamf/window/%u' % xid
+
+
+def application_path(xid):
+    return '/org/ayatana/bamf/application/%u' % xid
+
+
+class Window:
+    def __init__(self, xid):
+        self.xid = xid
+        self.path = window_path(xid)
+        self.app_path = application_path(xid)
+        self.registrations = []
+
+
+class MockBamf:
+    def __init__(self, loop):
+        self.loop = loop
+        self.bus = None
+        self.windows = {}
+        self.active = None
+
+    def emit(self, path, interface, signal, params):
+        self.bus.emit_signal(None, path, interface, signal, params)
+
+    def register(self, path, interface, call, prop=None):
+        def method_call(conn, sender, path, interface, method, params, invocation):
+            try:
+                ret = call(method, params.unpack())
+            except Exception as e:
+                invocation.return_dbus_error('org.ayatana.bamf.Error', str(e))
+                return
+            invocation.return_value(ret)
+
+        def get_property(conn, sender, path, interface, name):
+            return prop(name)
+
+        return self.bus.register_object(path, iface[interface], method_call,
+                                        get_property if prop else None, None)
+
+    def active_path(self):
+        return self.active.path if self.active is not None else ''
+
+    # Matcher
+    def matcher_call(self, method, args):
+        if method == 'ActiveWindow':
+            return GLib.Variant('(s)', (self.active_path(),))
+        if method == 'ActiveApplication':
+            return GLib.Variant('(s)', (self.active.app_path if self.active else '',))
+        if method == 'ApplicationForXid':
+            window = self.windows.get(args[0])
+            return GLib.Variant('(s)', (window.app_path if window else '',))
+        if method == 'ApplicationIsRunning':
+            return GLib.Variant('(b)', (False,))
+        if method == 'PathForApplication':
+            return GLib.Variant('(s)', ('',))
+        if method == 'RegisterFavorites':
+            return None
+        if method in ('ApplicationPaths', 'RunningApplications'):
+            return GLib.Variant('(as)', ([w.app_path for w in self.windows.values()],))
+        if method in ('RunningApplicationsDesktopFiles', 'TabPaths'):
+            return GLib.Variant('(as)', ([],))
+        if method in ('WindowPaths', 'WindowStackForMonitor'):
+            return GLib.Variant('(as)', ([w.path for w in self.windows.values()],))
+        if method == 'XidsForApplication':
+            xids = [w.xid for w in self.windows.values() if w.app_path == args[0]]
+            return GLib.Variant('(au)', (xids,))
+        raise Exception('Unknown method ' + method)
+
+    # Views, windows and applications
+    def view_call(self, window, is_app, method, args):
+        if method == 'Children':
+            return GLib.Variant('(as)', ([window.path] if is_app else [],))
+        if method == 'Parents':
+            return GLib.Variant('(as)', ([] if is_app else [window.app_path],))
+        if method == 'IsActive':
+            return GLib.Variant('(b)', (self.active is window,))
+        if method in ('IsRunning', 'IsUserVisible'):
+            return GLib.Variant('(b)', (True,))
+        if method == 'IsUrgent':
+            return GLib.Variant('(b)', (False,))
+        if method in ('Name', 'Icon'):
+            return GLib.Variant('(s)', (self.view_property(window, is_app, method),))
+        if method == 'ViewType':
+            return GLib.Variant('(s)', ('application' if is_app else 'window',))
+        raise Exception('Unknown method ' + method)
+
+    def view_property(self, window, is_app, name):
+        if name == 'Name':
+            return 'Bench %X' % window.xid
+        if name == 'Icon':
+            return ''
+        if name == 'Active':
+            return self.active is window
+        if name in ('Running', 'UserVisible'):
+            return True
+        return False
+
+    def window_call(self, window, method, args):
+        if method in ('GetXid', 'GetPid'):
+            return GLib.Variant('(u)', (window.xid if method == 'GetXid' else 0,))
+        if method == 'Transient':
+            return GLib.Variant('(s)', ('',))
+        if method == 'WindowType':
+            return GLib.Variant('(u)', (0,))
+        if method == 'Xprop':
+            return GLib.Variant('(s)', ('',))
+        if method in ('Monitor', 'Maximized'):
+            return GLib.Variant('(i)', (0,))
+        raise Exception('Unknown method ' + method)
+
+    def application_call(self, window, method, args):
+        if method == 'ApplicationType':
+            return GLib.Variant('(s)', ('system',))
+        if method == 'DesktopFile':
+            return GLib.Variant('(s)', ('',))
+        if method == 'FocusableChild':
+            return GLib.Variant('(s)', (window.path,))
+        if method == 'ShowStubs':
+            return GLib.Variant('(b)', (True,))
+        if method == 'SupportedMimeTypes':
+            return GLib.Variant('(as)', ([],))
+        if method == 'Xids':
+            return GLib.Variant('(au)', ([window.xid],))
+        raise Exception('Unknown method ' + method)
+
+    # Control
+    def add_window(self, xid):
+        if xid in self.windows:
+            return
+        window = Window(xid)
+        regs = window.registrations
+        prop_window = lambda name: GLib.Variant(
+            iface['org.ayatana.bamf.view'].lookup_property(name).signature,
+            self.view_property(window, False, name))
+        prop_app = lambda name: GLib.Variant(
+            iface['org.ayatana.bamf.view'].lookup_property(name).signature,
+            self.view_property(window, True, name))
+
+        regs.append(self.register(window.path, 'org.ayatana.bamf.view',
+                                  lambda m, a: self.view_call(window, False, m, a), prop_window))
+        regs.append(self.register(window.path, 'org.ayatana.bamf.window',
+                                  lambda m, a: self.window_call(window, m, a)))
+        regs.append(self.register(window.app_path, 'org.ayatana.bamf.view',
+                                  lambda m, a: self.view_call(window, True, m, a), prop_app))
+        regs.append(self.register(window.app_path, 'org.ayatana.bamf.application',
+                                  lambda m, a: self.application_call(window, m, a)))
+
+        self.windows[xid] = window
+        self.emit(MATCHER_PATH, 'org.ayatana.bamf.matcher', 'ViewOpened',
+                  GLib.Variant('(ss)', (window.app_path, 'application')))
+        self.emit(MATCHER_PATH, 'org.ayatana.bamf.matcher', 'ViewOpened',
+                  GLib.Variant('(ss)', (window.path, 'window')))
+
+    def remove_window(self, xid):
+        window = self.windows.pop(xid, None)
+        if window is None:
+            return
+        if self.active is window:
+            self.focus(0)
+        self.emit(window.path, 'org.ayatana.bamf.view', 'Closed', None)
+        self.emit(window.app_path, 'org.ayatana.bamf.view', 'Closed', None)
+        self.emit(MATCHER_PATH, 'org.ayatana.bamf.matcher', 'ViewClosed',
+                  GLib.Variant('(ss)', (window.path, 'window')))
+        self.emit(MATCHER_PATH, 'org.ayatana.bamf.matcher', 'ViewClosed',
+                  GLib.Variant('(ss)', (window.app_path, 'application')))
+        for reg in window.registrations:
+            self.bus.unregister_object(reg)
+
+    def focus(self, xid):
+        old = self.active
+        self.active = self.windows.get(xid)
+        old_path = old.path if old else ''
+        if old is not None:
+            self.emit(old.path, 'org.ayatana.bamf.view', 'ActiveChanged', GLib.Variant('(b)', (False,)))
+        if self.active is not None:
+            self.emit(self.active.path, 'org.ayatana.bamf.view', 'ActiveChanged', GLib.Variant('(b)', (True,)))
+        self.emit(MATCHER_PATH, 'org.ayatana.bamf.matcher', 'ActiveApplicationChanged',
+                  GLib.Variant('(ss)', (old.app_path if old else '',
+                                        self.active.app_path if self.active else '')))
+        self.emit(MATCHER_PATH, 'org.ayatana.bamf.matcher', 'ActiveWindowChanged',
+                  GLib.Variant('(ss)', (old_path, self.active_path())))
+
+    def bench_call(self, method, args):
+        if method == 'AddWindows':
+            for xid in args[0]:
+                self.add_window(xid)
+        elif method == 'RemoveWindows':
+            for xid in args[0]:
+                self.remove_window(xid)
+        elif method == 'Focus':
+            self.focus(args[0])
+        elif method == 'Quit':
+            GLib.idle_add(self.loop.quit)
+        else:
+            raise Exception('Unknown method ' + method)
+        return None
+
+    def bus_acquired(self, bus, name):
+        self.bus = bus
+        self.register(MATCHER_PATH, 'org.ayatana.bamf.matcher', self.matcher_call)
+        self.register(BENCH_PATH, 'org.ayatana.bamf.Bench', self.bench_call)
+
+    def name_lost(self, bus, name):
+        sys.stderr.write('Unable to get the name %s\n' % name)
+        self.loop.quit()
+
+
+def main():
+    loop = GLib.MainLoop()
+    mock = MockBamf(loop)
+    Gio.bus_own_name(Gio.BusType.SESSION, BAMF_NAME, Gio.BusNameOwnerFlags.NONE,
+                     mock.bus_acquired, None, mock.name_lost)
+    loop.run()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# Runs the benchmark headless: a private session bus, Xvfb, the mock
+# BAMF daemon and GSettings in memory with the schema from the tree.
+#
+#   run-bench.sh <appmenu-bench> <libayatana-appmenu.so> <schema dir> <output.json> [bench options]
+#
+# Needs dbus-run-session, xvfb-run, glib-compile-schemas and python3
+# with the GObject introspection bindings.
+
+set -e
+
+if [ $# -lt 4 ]; then
+	echo "Usage: $0 <appmenu-bench> <indicator module> <schema dir> <output> [options]" >&2
+	exit 1
+fi
+
+bench=$1
+indicator=$2
+schemadir=$3
+output=$4
+shift 4
+
+here=$(cd "$(dirname "$0")" && pwd)
+
+schemas=$(mktemp -d)
+trap 'rm -rf "$schemas"' EXIT
+cp "$schemadir"/*.gschema.xml "$schemas"
+glib-compile-schemas "$schemas"
+
+export GSETTINGS_SCHEMA_DIR="$schemas"
+export GSETTINGS_BACKEND=memory
+export NO_AT_BRIDGE=1
+
+xvfb-run -a -s "-screen 0 1024x768x24" \
+	dbus-run-session -- sh -c '
+		mock=$0 bench=$1 indicator=$2 output=$3
+		shift 3
+		python3 "$mock" &
+		pid=$!
+		status=0
+		"$bench" --indicator "$indicator" --output "$output" "$@" || status=$?
+		kill $pid 2>/dev/null
+		exit $status
+	' "$here/mock-bamf.py" "$bench" "$indicator" "$output" "$@"
+
+echo "Results are in $output"
@@ -0,0 +1,466 @@
+/*
+Tests of the entries the indicator puts on the panel as windows come,
+go and get focused.  The windows are followed through the fake tracker
+handed to the indicator with its window-tracker property.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <libdbusmenu-glib/menuitem.h>
+#include <libdbusmenu-glib/server.h>
+#include <libayatana-indicator/indicator-object.h>
+
+#include "dbus-shared.h"
+#include "window-tracker-fake.h"
+
+/* Nothing we wait for should take anywhere near this long */
+#define WAIT_TIMEOUT   5000
+
+/* The type of the indicator, from INDICATOR_SET_TYPE in the module */
+GType get_type (void);
+
+typedef struct _Fixture Fixture;
+struct _Fixture {
+	WindowTrackerFake * tracker;
+	IndicatorObject * indicator;
+	GPtrArray * windows;
+	guint added;
+	guint removed;
+};
+
+/* Sets the flag it's given when the wait has gone on too long */
+static gboolean
+wait_timeout (gpointer user_data)
+{
+	*(gboolean *)user_data = TRUE;
+	return G_SOURCE_REMOVE;
+}
+
+/* Run the main loop until @done says so, failing the test if it
+   doesn't happen in time */
+static void
+wait_for (gboolean (*done) (Fixture * fixture, gconstpointer data), Fixture * fixture, gconstpointer data)
+{
+	gboolean timed_out = FALSE;
+	guint timer = g_timeout_add(WAIT_TIMEOUT, wait_timeout, &timed_out);
+
+	while (!done(fixture, data)) {
+		if (timed_out) {
+			g_error("Timed out waiting on the indicator");
+		}
+
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	if (!timed_out) {
+		g_source_remove(timer);
+	}
+
+	return;
+}
+
+/* Run everything that's ready to go, which includes switching
+   the menus when the focus changed */
+static void
+settle (void)
+{
+	while (g_main_context_iteration(NULL, FALSE));
+	return;
+}
+
+static void
+entry_added (IndicatorObject * io, IndicatorObjectEntry * entry, gpointer user_data)
+{
+	((Fixture *)user_data)->added++;
+	return;
+}
+
+static void
+entry_removed (IndicatorObject * io, IndicatorObjectEntry * entry, gpointer user_data)
+{
+	((Fixture *)user_data)->removed++;
+	return;
+}
+
+/* The labels of the entries on the panel, separated by spaces */
+static gchar *
+entry_labels (Fixture * fixture)
+{
+	GList * entries = indicator_object_get_entries(fixture->indicator);
+	GString * labels = g_string_new(NULL);
+	GList * lentry;
+
+	for (lentry = entries; lentry != NULL; lentry = g_list_next(lentry)) {
+		IndicatorObjectEntry * entry = (IndicatorObjectEntry *)lentry->data;
+
+		if (labels->len > 0) {
+			g_string_append_c(labels, ' ');
+		}
+
+		if (entry->label != NULL) {
+			g_string_append(labels, gtk_label_get_label(entry->label));
+		}
+	}
+
+	g_list_free(entries);
+	return g_string_free(labels, FALSE);
+}
+
+static gboolean
+labels_are (Fixture * fixture, gconstpointer data)
+{
+	gchar * labels = entry_labels(fixture);
+	gboolean same = g_strcmp0(labels, data) == 0;
+	g_free(labels);
+	return same;
+}
+
+static guint
+entry_count (Fixture * fixture)
+{
+	GList * entries = indicator_object_get_entries(fixture->indicator);
+	guint count = g_list_length(entries);
+	g_list_free(entries);
+	return count;
+}
+
+/* A real X window to stand behind a fake one, the indicator asks
+   the X server about the windows it shows */
+static guint
+window_new (Fixture * fixture)
+{
+	GdkWindowAttr attributes = {0};
+
+	attributes.width = 1;
+	attributes.height = 1;
+	attributes.wclass = GDK_INPUT_OUTPUT;
+	attributes.window_type = GDK_WINDOW_TOPLEVEL;
+
+	GdkWindow * window = gdk_window_new(NULL, &attributes, 0);
+	g_ptr_array_add(fixture->windows, window);
+
+	return gdk_x11_window_get_xid(window);
+}
+
+static void
+fixture_setup (Fixture * fixture, gconstpointer data)
+{
+	fixture->tracker = window_tracker_fake_new();
+	fixture->windows = g_ptr_array_new_with_free_func((GDestroyNotify)gdk_window_destroy);
+
+	fixture->indicator = g_object_new(get_type(), "window-tracker", fixture->tracker, NULL);
+	g_signal_connect(fixture->indicator, INDICATOR_OBJECT_SIGNAL_ENTRY_ADDED, G_CALLBACK(entry_added), fixture);
+	g_signal_connect(fixture->indicator, INDICATOR_OBJECT_SIGNAL_ENTRY_REMOVED, G_CALLBACK(entry_removed), fixture);
+
+	/* The indicator hooks up to the tracker once it's idle */
+	settle();
+
+	return;
+}
+
+static void
+fixture_teardown (Fixture * fixture, gconstpointer data)
+{
+	g_clear_object(&fixture->indicator);
+	g_clear_object(&fixture->tracker);
+	g_ptr_array_free(fixture->windows, TRUE);
+
+	settle();
+
+	return;
+}
+
+/* Windows without menus of their own get the fallback menu, unless
+   the application asked not to */
+static void
+test_stubs_follow_focus (Fixture * fixture, gconstpointer data)
+{
+	guint plain = window_new(fixture);
+	guint blocked = window_new(fixture);
+
+	window_tracker_fake_open_window(fixture->tracker, plain, WINDOW_TRACKER_WINDOW_NORMAL, NULL);
+	window_tracker_fake_open_window(fixture->tracker, blocked, WINDOW_TRACKER_WINDOW_NORMAL, NULL);
+	window_tracker_fake_set_show_menu_stubs(fixture->tracker, blocked, FALSE);
+
+	g_assert_cmpuint(entry_count(fixture), ==, 0);
+
+	window_tracker_fake_focus(fixture->tracker, plain);
+	settle();
+	g_assert_cmpuint(fixture->added, ==, 1);
+	g_assert_cmpuint(entry_count(fixture), ==, 1);
+
+	window_tracker_fake_focus(fixture->tracker, blocked);
+	settle();
+	g_assert_cmpuint(fixture->removed, ==, 1);
+	g_assert_cmpuint(entry_count(fixture), ==, 0);
+
+	window_tracker_fake_focus(fixture->tracker, plain);
+	settle();
+	g_assert_cmpuint(fixture->added, ==, 2);
+	g_assert_cmpuint(entry_count(fixture), ==, 1);
+
+	return;
+}
+
+/* Going between two windows that show the same entries shouldn't
+   touch the panel at all */
+static void
+test_same_entries_kept (Fixture * fixture, gconstpointer data)
+{
+	guint first = window_new(fixture);
+	guint second = window_new(fixture);
+
+	window_tracker_fake_open_window(fixture->tracker, first, WINDOW_TRACKER_WINDOW_NORMAL, NULL);
+	window_tracker_fake_open_window(fixture->tracker, second, WINDOW_TRACKER_WINDOW_NORMAL, NULL);
+
+	window_tracker_fake_focus(fixture->tracker, first);
+	settle();
+	g_assert_cmpuint(fixture->added, ==, 1);
+
+	window_tracker_fake_focus(fixture->tracker, second);
+	settle();
+	g_assert_cmpuint(fixture->added, ==, 1);
+	g_assert_cmpuint(fixture->removed, ==, 0);
+	g_assert_cmpuint(entry_count(fixture), ==, 1);
+
+	return;
+}
+
+/* Only the last of a burst of focus changes gets its entries shown */
+static void
+test_focus_burst (Fixture * fixture, gconstpointer data)
+{
+	guint plain = window_new(fixture);
+	guint blocked = window_new(fixture);
+
+	window_tracker_fake_open_window(fixture->tracker, plain, WINDOW_TRACKER_WINDOW_NORMAL, NULL);
+	window_tracker_fake_open_window(fixture->tracker, blocked, WINDOW_TRACKER_WINDOW_NORMAL, NULL);
+	window_tracker_fake_set_show_menu_stubs(fixture->tracker, blocked, FALSE);
+
+	window_tracker_fake_focus(fixture->tracker, plain);
+	window_tracker_fake_focus(fixture->tracker, blocked);
+	settle();
+
+	g_assert_cmpuint(fixture->added, ==, 0);
+	g_assert_cmpuint(fixture->removed, ==, 0);
+
+	return;
+}
+
+/* Closing the focused window takes its entries with it */
+static void
+test_close_focused (Fixture * fixture, gconstpointer data)
+{
+	guint xid = window_new(fixture);
+
+	window_tracker_fake_open_window(fixture->tracker, xid, WINDOW_TRACKER_WINDOW_NORMAL, NULL);
+	window_tracker_fake_focus(fixture->tracker, xid);
+	settle();
+	g_assert_cmpuint(entry_count(fixture), ==, 1);
+
+	window_tracker_fake_close_window(fixture->tracker, xid);
+	settle();
+	g_assert_cmpuint(fixture->removed, ==, 1);
+	g_assert_cmpuint(entry_count(fixture), ==, 0);
+
+	return;
+}
+
+static gboolean
+name_owned (Fixture * fixture, gconstpointer data)
+{
+	return *(const gboolean *)data;
+}
+
+static void
+name_appeared (GDBusConnection * connection, const gchar * name, const gchar * owner, gpointer user_data)
+{
+	*(gboolean *)user_data = TRUE;
+	return;
+}
+
+static gboolean
+call_finished (Fixture * fixture, gconstpointer data)
+{
+	return *(GVariant * const *)data != NULL;
+}
+
+static void
+call_done (GObject * source, GAsyncResult * res, gpointer user_data)
+{
+	GError * error = NULL;
+	GVariant * ret = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+
+	g_assert_no_error(error);
+	*(GVariant **)user_data = ret;
+
+	return;
+}
+
+/* Call the registrar, which is in this process so it can't block */
+static void
+registrar_call (const gchar * method, GVariant * params)
+{
+	GDBusConnection * bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+	GVariant * ret = NULL;
+
+	g_dbus_connection_call(bus, DBUS_NAME, REG_OBJECT, REG_IFACE,
+	                       method, params, NULL,
+	                       G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+	                       call_done, &ret);
+	wait_for(call_finished, NULL, &ret);
+
+	g_variant_unref(ret);
+	g_object_unref(bus);
+
+	return;
+}
+
+/* A menubar like an application would have, @labels are its entries */
+static DbusmenuServer *
+menu_server_new (const gchar * path, const gchar * const * labels)
+{
+	DbusmenuServer * server = dbusmenu_server_new(path);
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+	guint i;
+
+	for (i = 0; labels[i] != NULL; i++) {
+		DbusmenuMenuitem * entry = dbusmenu_menuitem_new();
+		dbusmenu_menuitem_property_set(entry, DBUSMENU_MENUITEM_PROP_LABEL, labels[i]);
+		dbusmenu_menuitem_property_set(entry, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+
+		DbusmenuMenuitem * item = dbusmenu_menuitem_new();
+		dbusmenu_menuitem_property_set(item, DBUSMENU_MENUITEM_PROP_LABEL, "Item");
+		dbusmenu_menuitem_child_append(entry, item);
+		g_object_unref(item);
+
+		dbusmenu_menuitem_child_append(root, entry);
+		g_object_unref(entry);
+	}
+
+	dbusmenu_server_set_root(server, root);
+	g_object_unref(root);
+
+	return server;
+}
+
+/* Registered windows show their own menus when they're focused,
+   and lose them when they unregister */
+static void
+test_registered_menus (Fixture * fixture, gconstpointer data)
+{
+	const gchar * editor_labels[] = {"File", "Edit", "View", NULL};
+	const gchar * viewer_labels[] = {"Image", "Go", NULL};
+	gboolean owned = FALSE;
+
+	guint watch = g_bus_watch_name(G_BUS_TYPE_SESSION, DBUS_NAME, G_BUS_NAME_WATCHER_FLAGS_NONE,
+	                               name_appeared, NULL, &owned, NULL);
+	wait_for(name_owned, fixture, &owned);
+	g_bus_unwatch_name(watch);
+
+	guint editor = window_new(fixture);
+	guint viewer = window_new(fixture);
+	DbusmenuServer * editor_menus = menu_server_new("/test/editor", editor_labels);
+	DbusmenuServer * viewer_menus = menu_server_new("/test/viewer", viewer_labels);
+
+	window_tracker_fake_open_window(fixture->tracker, editor, WINDOW_TRACKER_WINDOW_NORMAL, NULL);
+	window_tracker_fake_open_window(fixture->tracker, viewer, WINDOW_TRACKER_WINDOW_NORMAL, NULL);
+
+	registrar_call("RegisterWindow", g_variant_new("(uo)", editor, "/test/editor"));
+	registrar_call("RegisterWindow", g_variant_new("(uo)", viewer, "/test/viewer"));
+
+	window_tracker_fake_focus(fixture->tracker, editor);
+	wait_for(labels_are, fixture, "File Edit View");
+
+	window_tracker_fake_focus(fixture->tracker, viewer);
+	wait_for(labels_are, fixture, "Image Go");
+
+	/* Every entry the panel was told about and not told to
+	   drop again is one that's there */
+	g_assert_cmpuint(fixture->added - fixture->removed, ==, 2);
+
+	registrar_call("UnregisterWindow", g_variant_new("(u)", viewer));
+	wait_for(labels_are, fixture, "");
+
+	g_object_unref(viewer_menus);
+	g_object_unref(editor_menus);
+
+	return;
+}
+
+/* Take out @path and whatever the indicator left in it */
+static void
+remove_tree (const gchar * path)
+{
+	GDir * dir = g_dir_open(path, 0, NULL);
+
+	if (dir != NULL) {
+		const gchar * name;
+
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			gchar * child = g_build_filename(path, name, NULL);
+			remove_tree(child);
+			g_free(child);
+		}
+
+		g_dir_close(dir);
+	}
+
+	g_remove(path);
+	return;
+}
+
+int
+main (int argc, char ** argv)
+{
+	/* Nothing from the session running the tests gets in */
+	gchar * runtime = g_dir_make_tmp("appmenu-test-XXXXXX", NULL);
+	g_setenv("XDG_RUNTIME_DIR", runtime, TRUE);
+	g_setenv("GSETTINGS_SCHEMA_DIR", SCHEMA_DIR, TRUE);
+	g_setenv("GSETTINGS_BACKEND", "memory", TRUE);
+	g_setenv("NO_AT_BRIDGE", "1", TRUE);
+
+	g_test_init(&argc, &argv, NULL);
+
+	if (!gtk_init_check(&argc, &argv)) {
+		g_print("No display to test with, skipping\n");
+		remove_tree(runtime);
+		g_free(runtime);
+		return 77;
+	}
+
+	/* A bus of our own for the registrar and the menus */
+	GTestDBus * bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+	g_test_dbus_up(bus);
+
+	g_test_add("/indicator-appmenu/stubs-follow-focus", Fixture, NULL, fixture_setup, test_stubs_follow_focus, fixture_teardown);
+	g_test_add("/indicator-appmenu/same-entries-kept", Fixture, NULL, fixture_setup, test_same_entries_kept, fixture_teardown);
+	g_test_add("/indicator-appmenu/focus-burst", Fixture, NULL, fixture_setup, test_focus_burst, fixture_teardown);
+	g_test_add("/indicator-appmenu/close-focused", Fixture, NULL, fixture_setup, test_close_focused, fixture_teardown);
+	g_test_add("/indicator-appmenu/registered-menus", Fixture, NULL, fixture_setup, test_registered_menus, fixture_teardown);
+
+	int ret = g_test_run();
+
+	g_test_dbus_down(bus);
+	g_object_unref(bus);
+	remove_tree(runtime);
+	g_free(runtime);
+
+	return ret;
+}
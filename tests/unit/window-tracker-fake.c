@@ -0,0 +1,320 @@
+/*
+An in-process window tracker for driving the indicator from tests.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "window-tracker-fake.h"
+
+/* Private parts */
+
+typedef struct _FakeWindow FakeWindow;
+struct _FakeWindow {
+	WindowTrackerWindowType type;
+	guint transient;
+	gboolean show_menu_stubs;
+	gchar * desktop_file;
+	GHashTable * props;
+};
+
+typedef struct _WindowTrackerFakePrivate WindowTrackerFakePrivate;
+struct _WindowTrackerFakePrivate {
+	GHashTable * windows;
+	guint active;
+};
+
+#define WINDOW_TRACKER_FAKE_GET_PRIVATE(o) \
+(G_TYPE_INSTANCE_GET_PRIVATE ((o), WINDOW_TRACKER_FAKE_TYPE, WindowTrackerFakePrivate))
+
+/* Prototypes */
+
+static void window_tracker_fake_class_init (WindowTrackerFakeClass *klass);
+static void window_tracker_fake_init       (WindowTrackerFake *self);
+static void window_tracker_fake_finalize   (GObject *object);
+
+static void fake_window_free (gpointer data);
+
+static guint                   get_active_window    (WindowTracker * tracker);
+static GArray *                get_windows          (WindowTracker * tracker);
+static gboolean                has_window           (WindowTracker * tracker,
+                                                     guint xid);
+static WindowTrackerWindowType get_window_type      (WindowTracker * tracker,
+                                                     guint xid);
+static guint                   get_transient        (WindowTracker * tracker,
+                                                     guint xid);
+static gchar *                 get_window_prop      (WindowTracker * tracker,
+                                                     guint xid,
+                                                     const gchar * name);
+static gchar *                 get_desktop_file     (WindowTracker * tracker,
+                                                     guint xid);
+static gboolean                get_show_menu_stubs  (WindowTracker * tracker,
+                                                     guint xid);
+
+G_DEFINE_TYPE (WindowTrackerFake, window_tracker_fake, WINDOW_TRACKER_TYPE);
+
+/* Build the one-time class */
+static void
+window_tracker_fake_class_init (WindowTrackerFakeClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (WindowTrackerFakePrivate));
+
+	object_class->finalize = window_tracker_fake_finalize;
+
+	WindowTrackerClass * tracker_class = WINDOW_TRACKER_CLASS(klass);
+	tracker_class->get_active_window = get_active_window;
+	tracker_class->get_windows = get_windows;
+	tracker_class->has_window = has_window;
+	tracker_class->get_window_type = get_window_type;
+	tracker_class->get_transient = get_transient;
+	tracker_class->get_window_prop = get_window_prop;
+	tracker_class->get_desktop_file = get_desktop_file;
+	tracker_class->get_show_menu_stubs = get_show_menu_stubs;
+
+	return;
+}
+
+/* Initialize the per-instance data */
+static void
+window_tracker_fake_init (WindowTrackerFake *self)
+{
+	WindowTrackerFakePrivate * priv = WINDOW_TRACKER_FAKE_GET_PRIVATE(self);
+
+	priv->windows = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, fake_window_free);
+	priv->active = 0;
+
+	return;
+}
+
+static void
+window_tracker_fake_finalize (GObject *object)
+{
+	WindowTrackerFakePrivate * priv = WINDOW_TRACKER_FAKE_GET_PRIVATE(object);
+
+	g_hash_table_destroy(priv->windows);
+
+	G_OBJECT_CLASS (window_tracker_fake_parent_class)->finalize (object);
+	return;
+}
+
+static void
+fake_window_free (gpointer data)
+{
+	FakeWindow * window = (FakeWindow *)data;
+
+	g_free(window->desktop_file);
+	g_hash_table_destroy(window->props);
+	g_slice_free(FakeWindow, window);
+
+	return;
+}
+
+static FakeWindow *
+lookup_window (WindowTracker * tracker, guint xid)
+{
+	WindowTrackerFakePrivate * priv = WINDOW_TRACKER_FAKE_GET_PRIVATE(tracker);
+	return g_hash_table_lookup(priv->windows, GUINT_TO_POINTER(xid));
+}
+
+static guint
+get_active_window (WindowTracker * tracker)
+{
+	WindowTrackerFakePrivate * priv = WINDOW_TRACKER_FAKE_GET_PRIVATE(tracker);
+	return priv->active;
+}
+
+static GArray *
+get_windows (WindowTracker * tracker)
+{
+	WindowTrackerFakePrivate * priv = WINDOW_TRACKER_FAKE_GET_PRIVATE(tracker);
+	GArray * xids = g_array_new(FALSE, FALSE, sizeof(guint));
+	GHashTableIter iter;
+	gpointer key;
+
+	g_hash_table_iter_init(&iter, priv->windows);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		guint xid = GPOINTER_TO_UINT(key);
+		g_array_append_val(xids, xid);
+	}
+
+	return xids;
+}
+
+static gboolean
+has_window (WindowTracker * tracker, guint xid)
+{
+	return lookup_window(tracker, xid) != NULL;
+}
+
+static WindowTrackerWindowType
+get_window_type (WindowTracker * tracker, guint xid)
+{
+	FakeWindow * window = lookup_window(tracker, xid);
+	return window != NULL ? window->type : WINDOW_TRACKER_WINDOW_OTHER;
+}
+
+static guint
+get_transient (WindowTracker * tracker, guint xid)
+{
+	FakeWindow * window = lookup_window(tracker, xid);
+	return window != NULL ? window->transient : 0;
+}
+
+static gchar *
+get_window_prop (WindowTracker * tracker, guint xid, const gchar * name)
+{
+	FakeWindow * window = lookup_window(tracker, xid);
+
+	if (window == NULL) {
+		return NULL;
+	}
+
+	return g_strdup(g_hash_table_lookup(window->props, name));
+}
+
+static gchar *
+get_desktop_file (WindowTracker * tracker, guint xid)
+{
+	FakeWindow * window = lookup_window(tracker, xid);
+	return window != NULL ? g_strdup(window->desktop_file) : NULL;
+}
+
+static gboolean
+get_show_menu_stubs (WindowTracker * tracker, guint xid)
+{
+	FakeWindow * window = lookup_window(tracker, xid);
+	return window != NULL ? window->show_menu_stubs : TRUE;
+}
+
+/**************************
+  API
+ **************************/
+
+/* A tracker whose windows only exist when the caller says so */
+WindowTrackerFake *
+window_tracker_fake_new (void)
+{
+	return g_object_new(WINDOW_TRACKER_FAKE_TYPE, NULL);
+}
+
+/* Adds a window, replacing any window with the same XID */
+void
+window_tracker_fake_open_window (WindowTrackerFake * fake, guint xid, WindowTrackerWindowType type, const gchar * desktop_file)
+{
+	g_return_if_fail(IS_WINDOW_TRACKER_FAKE(fake));
+	g_return_if_fail(xid != 0);
+
+	WindowTrackerFakePrivate * priv = WINDOW_TRACKER_FAKE_GET_PRIVATE(fake);
+
+	FakeWindow * window = g_slice_new0(FakeWindow);
+	window->type = type;
+	window->show_menu_stubs = TRUE;
+	window->desktop_file = g_strdup(desktop_file);
+	window->props = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+	g_hash_table_insert(priv->windows, GUINT_TO_POINTER(xid), window);
+	g_signal_emit_by_name(fake, WINDOW_TRACKER_SIGNAL_WINDOW_OPENED, xid);
+
+	return;
+}
+
+/* Drops the window, and the focus with it if it had it */
+void
+window_tracker_fake_close_window (WindowTrackerFake * fake, guint xid)
+{
+	g_return_if_fail(IS_WINDOW_TRACKER_FAKE(fake));
+
+	WindowTrackerFakePrivate * priv = WINDOW_TRACKER_FAKE_GET_PRIVATE(fake);
+
+	if (!g_hash_table_remove(priv->windows, GUINT_TO_POINTER(xid))) {
+		return;
+	}
+
+	if (priv->active == xid) {
+		priv->active = 0;
+	}
+
+	g_signal_emit_by_name(fake, WINDOW_TRACKER_SIGNAL_WINDOW_CLOSED, xid);
+
+	return;
+}
+
+/* Zero takes the focus away from everything */
+void
+window_tracker_fake_focus (WindowTrackerFake * fake, guint xid)
+{
+	g_return_if_fail(IS_WINDOW_TRACKER_FAKE(fake));
+
+	WindowTrackerFakePrivate * priv = WINDOW_TRACKER_FAKE_GET_PRIVATE(fake);
+	guint oldxid = priv->active;
+
+	if (xid != 0 && lookup_window(WINDOW_TRACKER(fake), xid) == NULL) {
+		g_warning("Focusing unknown window: %X", xid);
+		return;
+	}
+
+	priv->active = xid;
+	g_signal_emit_by_name(fake, WINDOW_TRACKER_SIGNAL_ACTIVE_WINDOW_CHANGED, oldxid, xid);
+
+	return;
+}
+
+void
+window_tracker_fake_set_transient (WindowTrackerFake * fake, guint xid, guint parent)
+{
+	g_return_if_fail(IS_WINDOW_TRACKER_FAKE(fake));
+
+	FakeWindow * window = lookup_window(WINDOW_TRACKER(fake), xid);
+	g_return_if_fail(window != NULL);
+
+	window->transient = parent;
+	return;
+}
+
+/* A NULL value removes the property */
+void
+window_tracker_fake_set_window_prop (WindowTrackerFake * fake, guint xid, const gchar * name, const gchar * value)
+{
+	g_return_if_fail(IS_WINDOW_TRACKER_FAKE(fake));
+	g_return_if_fail(name != NULL);
+
+	FakeWindow * window = lookup_window(WINDOW_TRACKER(fake), xid);
+	g_return_if_fail(window != NULL);
+
+	if (value == NULL) {
+		g_hash_table_remove(window->props, name);
+	} else {
+		g_hash_table_insert(window->props, g_strdup(name), g_strdup(value));
+	}
+
+	return;
+}
+
+void
+window_tracker_fake_set_show_menu_stubs (WindowTrackerFake * fake, guint xid, gboolean show)
+{
+	g_return_if_fail(IS_WINDOW_TRACKER_FAKE(fake));
+
+	FakeWindow * window = lookup_window(WINDOW_TRACKER(fake), xid);
+	g_return_if_fail(window != NULL);
+
+	window->show_menu_stubs = show;
+	return;
+}
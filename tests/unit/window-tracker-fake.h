@@ -0,0 +1,58 @@
+/*
+An in-process window tracker for driving the indicator from tests.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __WINDOW_TRACKER_FAKE_H__
+#define __WINDOW_TRACKER_FAKE_H__
+
+#include "window-tracker.h"
+
+G_BEGIN_DECLS
+
+#define WINDOW_TRACKER_FAKE_TYPE            (window_tracker_fake_get_type ())
+#define WINDOW_TRACKER_FAKE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), WINDOW_TRACKER_FAKE_TYPE, WindowTrackerFake))
+#define WINDOW_TRACKER_FAKE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), WINDOW_TRACKER_FAKE_TYPE, WindowTrackerFakeClass))
+#define IS_WINDOW_TRACKER_FAKE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), WINDOW_TRACKER_FAKE_TYPE))
+#define IS_WINDOW_TRACKER_FAKE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), WINDOW_TRACKER_FAKE_TYPE))
+#define WINDOW_TRACKER_FAKE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), WINDOW_TRACKER_FAKE_TYPE, WindowTrackerFakeClass))
+
+typedef struct _WindowTrackerFake      WindowTrackerFake;
+typedef struct _WindowTrackerFakeClass WindowTrackerFakeClass;
+
+struct _WindowTrackerFakeClass {
+	WindowTrackerClass parent_class;
+};
+
+struct _WindowTrackerFake {
+	WindowTracker parent;
+};
+
+GType window_tracker_fake_get_type (void);
+WindowTrackerFake * window_tracker_fake_new (void);
+
+/* Each of these emits its signals before returning */
+void window_tracker_fake_open_window (WindowTrackerFake * fake, guint xid, WindowTrackerWindowType type, const gchar * desktop_file);
+void window_tracker_fake_close_window (WindowTrackerFake * fake, guint xid);
+void window_tracker_fake_focus (WindowTrackerFake * fake, guint xid);
+
+void window_tracker_fake_set_transient (WindowTrackerFake * fake, guint xid, guint parent);
+void window_tracker_fake_set_window_prop (WindowTrackerFake * fake, guint xid, const gchar * name, const gchar * value);
+void window_tracker_fake_set_show_menu_stubs (WindowTrackerFake * fake, guint xid, gboolean show);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,897 @@
+/*
+Puts up lots of windows with menus and keeps the registrar busy with
+them, to reproduce heavy sessions on a single machine.
+
+Copyright 2026 Canonical Ltd.
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3, as published
+by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranties of
+MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <glib-unix.h>
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <gio/gio.h>
+#include <libdbusmenu-glib/menuitem.h>
+#include <libdbusmenu-glib/server.h>
+
+#include "../src/dbus-shared.h"
+
+/* Every client is its own process with its own bus connection, so
+   that one vanishing looks like an application going away.  The
+   first process only runs the clients, running itself again with
+   --client, and puts them back when they vanish. */
+
+#define DBUSMENU_IFACE   "com.canonical.dbusmenu"
+#define GTK_MENUS_IFACE  "org.gtk.Menus"
+
+/* Exit status of a client that vanished on purpose */
+#define VANISHED_STATUS  3
+
+typedef struct _LoadWindow LoadWindow;
+struct _LoadWindow {
+	GdkWindow * window;
+	guint xid;
+	gboolean registered;
+	gboolean hinted;
+
+	/* dbusmenu */
+	gchar * path;
+	DbusmenuServer * server;
+
+	/* GMenuModel */
+	gchar * menubar_path;
+	gchar * window_path;
+	guint menubar_export;
+	guint actions_export;
+};
+
+/* An item whose label can be changed, see churn_label() */
+typedef struct _LoadItem LoadItem;
+struct _LoadItem {
+	DbusmenuMenuitem * item;
+	GMenu * menu;
+	gint position;
+};
+
+/* Options */
+static gint windows = 20;
+static gint clients = 1;
+static gchar * transport = NULL;
+static gint menu_width = 6;
+static gint menu_depth = 1;
+static gint menu_length = 10;
+static gdouble churn_rate = 0.0;
+static gdouble prop_rate = 0.0;
+static gdouble register_rate = 0.0;
+static gdouble focus_rate = 1.0;
+static gint slow_delay = 0;
+static gdouble slow_fraction = 0.0;
+static gdouble drop_fraction = 0.0;
+static gdouble vanish_fraction = 0.0;
+static gint respawn_delay = 1000;
+static gint duration = 0;
+static gint seed = 0;
+static gint client_index = -1;
+static gint client_windows = 0;
+
+static GOptionEntry options[] = {
+	{"windows",        'n', 0, G_OPTION_ARG_INT,    &windows,         "Windows to put up across all the clients (20)", "N"},
+	{"clients",        'c', 0, G_OPTION_ARG_INT,    &clients,         "Client processes to spread the windows over (1)", "N"},
+	{"transport",      't', 0, G_OPTION_ARG_STRING, &transport,       "How the menus are exported: dbusmenu, model or mixed (dbusmenu)", "NAME"},
+	{"width",          'w', 0, G_OPTION_ARG_INT,    &menu_width,      "Entries on each window's menubar (6)", "N"},
+	{"depth",          'd', 0, G_OPTION_ARG_INT,    &menu_depth,      "Levels of submenus under each entry (1)", "N"},
+	{"length",         'l', 0, G_OPTION_ARG_INT,    &menu_length,     "Items in each submenu (10)", "N"},
+	{"churn-rate",     0,   0, G_OPTION_ARG_DOUBLE, &churn_rate,      "Label changes per second in each client (0)", "RATE"},
+	{"prop-rate",      0,   0, G_OPTION_ARG_DOUBLE, &prop_rate,       "Window property changes per second in each client (0)", "RATE"},
+	{"register-rate",  0,   0, G_OPTION_ARG_DOUBLE, &register_rate,   "Windows registered or unregistered per second in each client (0)", "RATE"},
+	{"focus-rate",     0,   0, G_OPTION_ARG_DOUBLE, &focus_rate,      "Focus changes per second in each client (1)", "RATE"},
+	{"slow-delay",     0,   0, G_OPTION_ARG_INT,    &slow_delay,      "Milliseconds that slow replies are held back (0)", "MS"},
+	{"slow-fraction",  0,   0, G_OPTION_ARG_DOUBLE, &slow_fraction,   "Fraction of replies that are slow (0)", "P"},
+	{"drop-fraction",  0,   0, G_OPTION_ARG_DOUBLE, &drop_fraction,   "Fraction of replies that are never sent (0)", "P"},
+	{"vanish-fraction",0,   0, G_OPTION_ARG_DOUBLE, &vanish_fraction, "Fraction of layout requests where the client exits instead of answering (0)", "P"},
+	{"respawn-delay",  0,   0, G_OPTION_ARG_INT,    &respawn_delay,   "Milliseconds before a vanished client comes back (1000)", "MS"},
+	{"duration",       0,   0, G_OPTION_ARG_INT,    &duration,        "Seconds to run for, forever when zero (0)", "S"},
+	{"seed",           0,   0, G_OPTION_ARG_INT,    &seed,            "Seed for the random schedules, from the time when zero (0)", "N"},
+	{"client",         0,   G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT, &client_index,   NULL, NULL},
+	{"client-windows", 0,   G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT, &client_windows, NULL, NULL},
+	{NULL}
+};
+
+/* Client state */
+static GDBusConnection * bus = NULL;
+static GPtrArray * load_windows = NULL;
+static GArray * load_items = NULL;
+static GRand * schedule_rand = NULL;
+static gboolean registrar_up = FALSE;
+static GMutex resend_lock;
+static GHashTable * resending = NULL;
+
+/* What happened, printed when the client exits */
+enum {
+	STAT_REGISTER,
+	STAT_UNREGISTER,
+	STAT_FOCUS,
+	STAT_CHURN,
+	STAT_PROP,
+	STAT_SLOW,
+	STAT_DROP,
+	N_STATS
+};
+
+static const gchar * stat_names[N_STATS] = {
+	"registered",
+	"unregistered",
+	"focused",
+	"labels changed",
+	"properties changed",
+	"replies slowed",
+	"replies dropped"
+};
+
+static gint stats[N_STATS];
+
+/**************************
+  Fault injection
+ **************************/
+
+static gboolean
+resend_cb (gpointer user_data)
+{
+	GDBusMessage * message = G_DBUS_MESSAGE(user_data);
+	GError * error = NULL;
+
+	g_dbus_connection_send_message(bus, message, G_DBUS_SEND_MESSAGE_FLAGS_PRESERVE_SERIAL, NULL, &error);
+	if (error != NULL) {
+		g_warning("Unable to send delayed reply: %s", error->message);
+		g_error_free(error);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Whether an incoming call is asking for a menu layout */
+static gboolean
+is_layout_call (GDBusMessage * message)
+{
+	const gchar * iface = g_dbus_message_get_interface(message);
+	const gchar * member = g_dbus_message_get_member(message);
+
+	return (g_strcmp0(iface, DBUSMENU_IFACE) == 0 && g_strcmp0(member, "GetLayout") == 0) ||
+	       (g_strcmp0(iface, GTK_MENUS_IFACE) == 0 && g_strcmp0(member, "Start") == 0);
+}
+
+/* Runs in the GDBus worker thread on every message, so it only uses
+   the thread safe random numbers and hands delayed replies to the
+   main loop. */
+static GDBusMessage *
+fault_filter (GDBusConnection * connection, GDBusMessage * message, gboolean incoming, gpointer user_data)
+{
+	if (incoming) {
+		if (g_dbus_message_get_message_type(message) == G_DBUS_MESSAGE_TYPE_METHOD_CALL &&
+		    is_layout_call(message) && g_random_double() < vanish_fraction) {
+			g_print("Client %d vanishing in the middle of '%s'\n", getpid(), g_dbus_message_get_member(message));
+			_exit(VANISHED_STATUS);
+		}
+
+		return message;
+	}
+
+	if (g_dbus_message_get_message_type(message) != G_DBUS_MESSAGE_TYPE_METHOD_RETURN) {
+		return message;
+	}
+
+	/* The delayed ones come through here again */
+	g_mutex_lock(&resend_lock);
+	gboolean resent = g_hash_table_remove(resending, message);
+	g_mutex_unlock(&resend_lock);
+
+	if (resent) {
+		return message;
+	}
+
+	gdouble dice = g_random_double();
+
+	if (dice < drop_fraction) {
+		g_atomic_int_inc(&stats[STAT_DROP]);
+		g_object_unref(message);
+		return NULL;
+	}
+
+	if (dice < drop_fraction + slow_fraction) {
+		GError * error = NULL;
+		GDBusMessage * copy = g_dbus_message_copy(message, &error);
+
+		if (copy == NULL) {
+			g_warning("Unable to copy reply: %s", error->message);
+			g_error_free(error);
+			return message;
+		}
+
+		g_mutex_lock(&resend_lock);
+		g_hash_table_add(resending, copy);
+		g_mutex_unlock(&resend_lock);
+
+		g_atomic_int_inc(&stats[STAT_SLOW]);
+
+		GSource * source = g_timeout_source_new(slow_delay);
+		g_source_set_callback(source, resend_cb, copy, g_object_unref);
+		g_source_attach(source, NULL);
+		g_source_unref(source);
+
+		g_object_unref(message);
+		return NULL;
+	}
+
+	return message;
+}
+
+/**************************
+  Menus
+ **************************/
+
+static gchar *
+item_label (const gchar * prefix, gint index)
+{
+	return g_strdup_printf("%s %d.%d", prefix, index, g_rand_int_range(schedule_rand, 0, 1000));
+}
+
+static void
+build_dbusmenu_level (DbusmenuMenuitem * parent, gint level)
+{
+	gint i;
+
+	for (i = 0; i < menu_length; i++) {
+		DbusmenuMenuitem * item = dbusmenu_menuitem_new();
+		gchar * label = item_label(level < menu_depth ? "Submenu" : "Item", i);
+
+		dbusmenu_menuitem_property_set(item, DBUSMENU_MENUITEM_PROP_LABEL, label);
+		g_free(label);
+
+		if (level < menu_depth) {
+			build_dbusmenu_level(item, level + 1);
+		} else {
+			LoadItem litem = { item, NULL, 0 };
+			g_array_append_val(load_items, litem);
+		}
+
+		dbusmenu_menuitem_child_append(parent, item);
+		g_object_unref(item);
+	}
+
+	return;
+}
+
+static DbusmenuMenuitem *
+build_dbusmenu (void)
+{
+	DbusmenuMenuitem * root = dbusmenu_menuitem_new();
+	gint i;
+
+	for (i = 0; i < menu_width; i++) {
+		DbusmenuMenuitem * entry = dbusmenu_menuitem_new();
+		gchar * label = g_strdup_printf("Menu %d", i);
+
+		dbusmenu_menuitem_property_set(entry, DBUSMENU_MENUITEM_PROP_LABEL, label);
+		dbusmenu_menuitem_property_set(entry, DBUSMENU_MENUITEM_PROP_CHILD_DISPLAY, DBUSMENU_MENUITEM_CHILD_DISPLAY_SUBMENU);
+		g_free(label);
+
+		build_dbusmenu_level(entry, 1);
+
+		dbusmenu_menuitem_child_append(root, entry);
+		g_object_unref(entry);
+	}
+
+	return root;
+}
+
+static GMenu *
+build_model_level (gint level)
+{
+	GMenu * menu = g_menu_new();
+	gint i;
+
+	for (i = 0; i < menu_length; i++) {
+		gchar * label = item_label(level < menu_depth ? "Submenu" : "Item", i);
+
+		if (level < menu_depth) {
+			GMenu * submenu = build_model_level(level + 1);
+			g_menu_append_submenu(menu, label, G_MENU_MODEL(submenu));
+			g_object_unref(submenu);
+		} else {
+			LoadItem litem = { NULL, g_object_ref(menu), i };
+			g_menu_append(menu, label, "win.activate");
+			g_array_append_val(load_items, litem);
+		}
+
+		g_free(label);
+	}
+
+	return menu;
+}
+
+static GMenu *
+build_model (void)
+{
+	GMenu * menubar = g_menu_new();
+	gint i;
+
+	for (i = 0; i < menu_width; i++) {
+		GMenu * submenu = build_model_level(1);
+		gchar * label = g_strdup_printf("Menu %d", i);
+
+		g_menu_append_submenu(menubar, label, G_MENU_MODEL(submenu));
+
+		g_object_unref(submenu);
+		g_free(label);
+	}
+
+	return menubar;
+}
+
+/* Replace the label of a random item, GMenu items can't change so
+   they get swapped for a new one */
+static void
+churn_label (void)
+{
+	if (load_items->len == 0) {
+		return;
+	}
+
+	LoadItem * litem = &g_array_index(load_items, LoadItem, g_rand_int_range(schedule_rand, 0, load_items->len));
+	gchar * label = item_label("Item", litem->position);
+
+	if (litem->item != NULL) {
+		dbusmenu_menuitem_property_set(litem->item, DBUSMENU_MENUITEM_PROP_LABEL, label);
+	} else {
+		g_menu_remove(litem->menu, litem->position);
+		g_menu_insert(litem->menu, litem->position, label, "win.activate");
+	}
+
+	g_free(label);
+	stats[STAT_CHURN]++;
+
+	return;
+}
+
+/**************************
+  Windows
+ **************************/
+
+static void
+set_utf8_prop (GdkWindow * window, const gchar * name, const gchar * value)
+{
+	gdk_property_change(window,
+	                    gdk_atom_intern(name, FALSE),
+	                    gdk_atom_intern_static_string("UTF8_STRING"),
+	                    8, GDK_PROP_MODE_REPLACE,
+	                    (const guchar *)value, strlen(value));
+	return;
+}
+
+/* The GMenuModel properties, setting them again is also how
+   property changes get made on those windows */
+static void
+set_model_props (LoadWindow * lwindow)
+{
+	set_utf8_prop(lwindow->window, "_GTK_UNIQUE_BUS_NAME", g_dbus_connection_get_unique_name(bus));
+	set_utf8_prop(lwindow->window, "_GTK_MENUBAR_OBJECT_PATH", lwindow->menubar_path);
+	set_utf8_prop(lwindow->window, "_GTK_WINDOW_OBJECT_PATH", lwindow->window_path);
+	return;
+}
+
+static LoadWindow *
+load_window_new (guint index, gboolean model)
+{
+	LoadWindow * lwindow = g_new0(LoadWindow, 1);
+	GdkWindowAttr attributes = { 0 };
+
+	attributes.title = g_strdup_printf("Load %d:%u", getpid(), index);
+	attributes.width = 200;
+	attributes.height = 100;
+	attributes.wclass = GDK_INPUT_OUTPUT;
+	attributes.event_mask = GDK_PROPERTY_CHANGE_MASK | GDK_STRUCTURE_MASK;
+	attributes.window_type = GDK_WINDOW_TOPLEVEL;
+
+	lwindow->window = gdk_window_new(NULL, &attributes, GDK_WA_TITLE);
+	lwindow->xid = GDK_WINDOW_XID(lwindow->window);
+	g_free(attributes.title);
+
+	if (model) {
+		GError * error = NULL;
+		GMenu * menubar = build_model();
+		GSimpleActionGroup * actions = g_simple_action_group_new();
+		GSimpleAction * action = g_simple_action_new("activate", NULL);
+
+		g_action_map_add_action(G_ACTION_MAP(actions), G_ACTION(action));
+		g_object_unref(action);
+
+		lwindow->menubar_path = g_strdup_printf("/load/window/%u/menubar", index);
+		lwindow->window_path = g_strdup_printf("/load/window/%u", index);
+
+		lwindow->menubar_export = g_dbus_connection_export_menu_model(bus, lwindow->menubar_path, G_MENU_MODEL(menubar), &error);
+		if (error != NULL) {
+			g_warning("Unable to export menubar: %s", error->message);
+			g_clear_error(&error);
+		}
+
+		lwindow->actions_export = g_dbus_connection_export_action_group(bus, lwindow->window_path, G_ACTION_GROUP(actions), &error);
+		if (error != NULL) {
+			g_warning("Unable to export actions: %s", error->message);
+			g_clear_error(&error);
+		}
+
+		g_object_unref(menubar);
+		g_object_unref(actions);
+
+		set_model_props(lwindow);
+	} else {
+		DbusmenuMenuitem * root = build_dbusmenu();
+
+		lwindow->path = g_strdup_printf("/load/menu/%u", index);
+		lwindow->server = dbusmenu_server_new(lwindow->path);
+		dbusmenu_server_set_root(lwindow->server, root);
+
+		g_object_unref(root);
+	}
+
+	gdk_window_show(lwindow->window);
+	lwindow->registered = TRUE;
+
+	return lwindow;
+}
+
+static void
+register_window (LoadWindow * lwindow)
+{
+	if (lwindow->path != NULL) {
+		if (registrar_up) {
+			g_dbus_connection_call(bus, DBUS_NAME, REG_OBJECT, REG_IFACE, "RegisterWindow",
+			                       g_variant_new("(uo)", lwindow->xid, lwindow->path),
+			                       NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+		}
+	} else {
+		gdk_window_show(lwindow->window);
+	}
+
+	lwindow->registered = TRUE;
+	stats[STAT_REGISTER]++;
+
+	return;
+}
+
+/* GMenuModel windows can't unregister, so they go away instead */
+static void
+unregister_window (LoadWindow * lwindow)
+{
+	if (lwindow->path != NULL) {
+		if (registrar_up) {
+			g_dbus_connection_call(bus, DBUS_NAME, REG_OBJECT, REG_IFACE, "UnregisterWindow",
+			                       g_variant_new("(u)", lwindow->xid),
+			                       NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+		}
+	} else {
+		gdk_window_hide(lwindow->window);
+	}
+
+	lwindow->registered = FALSE;
+	stats[STAT_UNREGISTER]++;
+
+	return;
+}
+
+static LoadWindow *
+random_window (void)
+{
+	return g_ptr_array_index(load_windows, g_rand_int_range(schedule_rand, 0, load_windows->len));
+}
+
+static void
+toggle_registration (void)
+{
+	LoadWindow * lwindow = random_window();
+
+	if (lwindow->registered) {
+		unregister_window(lwindow);
+	} else {
+		register_window(lwindow);
+	}
+
+	return;
+}
+
+static void
+focus_window (void)
+{
+	LoadWindow * lwindow = random_window();
+
+	if (!lwindow->registered && lwindow->path == NULL) {
+		/* Hidden, can't take the focus */
+		return;
+	}
+
+	gdk_window_focus(lwindow->window, gdk_x11_get_server_time(lwindow->window));
+	stats[STAT_FOCUS]++;
+
+	return;
+}
+
+/* Changes properties that the registrar watches on the window */
+static void
+change_props (void)
+{
+	LoadWindow * lwindow = random_window();
+
+	lwindow->hinted = !lwindow->hinted;
+	gdk_window_set_functions(lwindow->window, lwindow->hinted ? GDK_FUNC_MOVE | GDK_FUNC_CLOSE : GDK_FUNC_ALL);
+
+	if (lwindow->menubar_path != NULL) {
+		set_model_props(lwindow);
+	}
+
+	stats[STAT_PROP]++;
+
+	return;
+}
+
+/**************************
+  Schedules
+ **************************/
+
+typedef struct _Schedule Schedule;
+struct _Schedule {
+	gdouble rate;
+	void (*func) (void);
+};
+
+static gboolean schedule_cb (gpointer user_data);
+
+/* Random arrivals at @rate a second, so things bunch up sometimes
+   like they do with real users */
+static void
+schedule_next (Schedule * schedule)
+{
+	gdouble wait = -log(1.0 - g_rand_double(schedule_rand)) / schedule->rate;
+
+	g_timeout_add(MAX(1, (guint)(wait * 1000.0)), schedule_cb, schedule);
+
+	return;
+}
+
+static gboolean
+schedule_cb (gpointer user_data)
+{
+	Schedule * schedule = (Schedule *)user_data;
+
+	schedule->func();
+	schedule_next(schedule);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_start (gdouble rate, void (*func) (void))
+{
+	if (rate <= 0.0) {
+		return;
+	}
+
+	Schedule * schedule = g_new0(Schedule, 1);
+	schedule->rate = rate;
+	schedule->func = func;
+
+	schedule_next(schedule);
+
+	return;
+}
+
+/**************************
+  Client
+ **************************/
+
+static void
+registrar_appeared (GDBusConnection * connection, const gchar * name, const gchar * owner, gpointer user_data)
+{
+	guint i;
+
+	registrar_up = TRUE;
+
+	for (i = 0; i < load_windows->len; i++) {
+		LoadWindow * lwindow = g_ptr_array_index(load_windows, i);
+
+		if (lwindow->path != NULL && lwindow->registered) {
+			register_window(lwindow);
+		}
+	}
+
+	return;
+}
+
+static void
+registrar_vanished (GDBusConnection * connection, const gchar * name, gpointer user_data)
+{
+	registrar_up = FALSE;
+	return;
+}
+
+static void
+print_stats (void)
+{
+	guint i;
+
+	g_print("Client %d:", getpid());
+	for (i = 0; i < N_STATS; i++) {
+		g_print(" %d %s%s", stats[i], stat_names[i], i + 1 < N_STATS ? "," : "\n");
+	}
+
+	return;
+}
+
+static gboolean
+client_quit (gpointer user_data)
+{
+	gtk_main_quit();
+	return G_SOURCE_REMOVE;
+}
+
+static int
+client_main (guint count)
+{
+	GError * error = NULL;
+	guint i;
+
+	g_random_set_seed(seed);
+	schedule_rand = g_rand_new_with_seed(seed);
+
+	/* The shared connection, dbusmenu uses that one too and
+	   everything has to go through the filter */
+	bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+	if (bus == NULL) {
+		g_warning("Unable to get session bus: %s", error->message);
+		g_error_free(error);
+		return 1;
+	}
+
+	resending = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_dbus_connection_add_filter(bus, fault_filter, NULL, NULL);
+
+	load_windows = g_ptr_array_new();
+	load_items = g_array_new(FALSE, FALSE, sizeof(LoadItem));
+
+	for (i = 0; i < count; i++) {
+		gboolean model = FALSE;
+
+		if (g_strcmp0(transport, "model") == 0) {
+			model = TRUE;
+		} else if (g_strcmp0(transport, "mixed") == 0) {
+			model = (i % 2) == 1;
+		}
+
+		g_ptr_array_add(load_windows, load_window_new(i, model));
+	}
+
+	g_print("Client %d up with %u windows and %u items\n", getpid(), count, load_items->len);
+
+	g_bus_watch_name_on_connection(bus, DBUS_NAME, G_BUS_NAME_WATCHER_FLAGS_NONE,
+	                               registrar_appeared, registrar_vanished, NULL, NULL);
+
+	if (count > 0) {
+		schedule_start(churn_rate, churn_label);
+		schedule_start(prop_rate, change_props);
+		schedule_start(register_rate, toggle_registration);
+		schedule_start(focus_rate, focus_window);
+	}
+
+	if (duration > 0) {
+		g_timeout_add_seconds(duration, client_quit, NULL);
+	}
+
+	g_unix_signal_add(SIGTERM, client_quit, NULL);
+	g_unix_signal_add(SIGINT, client_quit, NULL);
+
+	gtk_main();
+
+	print_stats();
+
+	return 0;
+}
+
+/**************************
+  Supervisor
+ **************************/
+
+static GMainLoop * mainloop = NULL;
+static gchar ** client_argv = NULL;
+static GPid * children = NULL;
+static gint64 deadline = 0;
+static gint vanished = 0;
+static gint live = 0;
+
+static void spawn_client (gint index);
+
+static gboolean
+respawn_cb (gpointer user_data)
+{
+	/* Time ran out, or we were told to stop, while waiting */
+	if (deadline != 0 && g_get_monotonic_time() >= deadline) {
+		if (live == 0) {
+			g_main_loop_quit(mainloop);
+		}
+		return G_SOURCE_REMOVE;
+	}
+
+	spawn_client(GPOINTER_TO_INT(user_data));
+	return G_SOURCE_REMOVE;
+}
+
+static void
+client_exited (GPid pid, gint status, gpointer user_data)
+{
+	gint index = GPOINTER_TO_INT(user_data);
+
+	g_spawn_close_pid(pid);
+	children[index] = 0;
+	live--;
+
+	if (WIFEXITED(status) && WEXITSTATUS(status) == VANISHED_STATUS &&
+	    (deadline == 0 || g_get_monotonic_time() < deadline)) {
+		vanished++;
+		g_timeout_add(respawn_delay, respawn_cb, GINT_TO_POINTER(index));
+		return;
+	}
+
+	if (live == 0) {
+		g_main_loop_quit(mainloop);
+	}
+
+	return;
+}
+
+/* Runs ourselves again as client @index, windows are spread over
+   the clients as evenly as they go */
+static void
+spawn_client (gint index)
+{
+	guint count = windows / clients + (index < windows % clients ? 1 : 0);
+	guint len = g_strv_length(client_argv);
+	gchar ** argv = g_new0(gchar *, len + 5);
+	GError * error = NULL;
+	GPid pid = 0;
+	guint i;
+
+	/* We may have been started by name from the path */
+	argv[0] = "/proc/self/exe";
+	for (i = 1; i < len; i++) {
+		argv[i] = client_argv[i];
+	}
+
+	/* Later options win, and vanished clients come back with a
+	   different schedule and only for the time that's left */
+	argv[len] = g_strdup_printf("--client=%d", index);
+	argv[len + 1] = g_strdup_printf("--client-windows=%u", count);
+	argv[len + 2] = g_strdup_printf("--seed=%d", seed + index + vanished * clients);
+	if (duration > 0) {
+		gint64 remaining = deadline - g_get_monotonic_time();
+		argv[len + 3] = g_strdup_printf("--duration=%d", (gint)MAX(1, (remaining + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC));
+	}
+
+	if (!g_spawn_async(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, &error)) {
+		g_warning("Unable to start client %d: %s", index, error->message);
+		g_error_free(error);
+	} else {
+		children[index] = pid;
+		live++;
+		g_child_watch_add(pid, client_exited, GINT_TO_POINTER(index));
+	}
+
+	g_free(argv[len]);
+	g_free(argv[len + 1]);
+	g_free(argv[len + 2]);
+	g_free(argv[len + 3]);
+	g_free(argv);
+
+	return;
+}
+
+static gboolean
+supervisor_quit (gpointer user_data)
+{
+	gint i;
+
+	for (i = 0; i < clients; i++) {
+		if (children[i] != 0) {
+			kill(children[i], SIGTERM);
+		}
+	}
+
+	/* Don't bring them back */
+	deadline = 1;
+
+	return G_SOURCE_REMOVE;
+}
+
+int
+main (int argc, char ** argv)
+{
+	GError * error = NULL;
+	GOptionContext * context = g_option_context_new("- put load on the application menu registrar");
+	gchar ** original_argv = g_strdupv(argv);
+	gint i;
+
+	g_option_context_add_main_entries(context, options, NULL);
+	g_option_context_add_group(context, gtk_get_option_group(FALSE));
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	if (transport == NULL) {
+		transport = g_strdup("dbusmenu");
+	}
+
+	if (g_strcmp0(transport, "dbusmenu") != 0 && g_strcmp0(transport, "model") != 0 && g_strcmp0(transport, "mixed") != 0) {
+		g_printerr("Unknown transport '%s'\n", transport);
+		return 1;
+	}
+
+	if (windows < 0 || clients < 1 || menu_width < 0 || menu_depth < 1 || menu_length < 0) {
+		g_printerr("Window, client and menu counts need to be positive\n");
+		return 1;
+	}
+
+	if (client_index >= 0) {
+		gtk_init(&argc, &argv);
+		return client_main(client_windows);
+	}
+
+	if (seed == 0) {
+		seed = (gint)(g_get_real_time() & G_MAXINT);
+	}
+
+	g_print("Seed: %d\n", seed);
+
+	client_argv = original_argv;
+	mainloop = g_main_loop_new(NULL, FALSE);
+	children = g_new0(GPid, clients);
+
+	if (duration > 0) {
+		deadline = g_get_monotonic_time() + (gint64)duration * G_USEC_PER_SEC;
+	}
+
+	for (i = 0; i < clients; i++) {
+		spawn_client(i);
+	}
+
+	g_unix_signal_add(SIGTERM, supervisor_quit, NULL);
+	g_unix_signal_add(SIGINT, supervisor_quit, NULL);
+
+	if (live > 0) {
+		g_main_loop_run(mainloop);
+	}
+
+	g_print("%d clients vanished on purpose\n", vanished);
+
+	g_main_loop_unref(mainloop);
+	g_strfreev(client_argv);
+	g_free(children);
+
+	return 0;
+}